@@ -0,0 +1,53 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// APNG 中一帧的位置与合成方式（fcTL）
+struct ApngFrame {
+  cv::Rect region;      // 帧在画布上的区域
+  int delayMs = 0;      // 显示时长（毫秒）
+  int dispose = 0;      // 0 = 保留，1 = 清为透明，2 = 恢复到绘制前
+  int blend = 0;        // 0 = 覆盖区域，1 = 按 alpha 叠加
+  // 帧数据所在的 IDAT / fdAT 数据段（偏移与长度，不含序号）
+  std::vector<std::pair<size_t, size_t>> chunks;
+};
+
+// 解析内存中的 APNG（acTL / fcTL / fdAT），按 blend 与 dispose 合成完整帧。
+// 每帧的压缩数据相互独立，各帧在多个线程上并行解压，合成按顺序进行，
+// 同时只保留一批已解码的帧
+class ApngReader {
+ public:
+  // data 在 reader 使用期间必须保持有效
+  explicit ApngReader(const std::vector<uchar>& data);
+
+  // 读取文件头与全部帧的位置，不是 APNG 或结构损坏时返回 false
+  bool Open();
+
+  cv::Size CanvasSize() const { return canvas_; }
+  int LoopCount() const { return loops_; }  // 0 表示无限循环
+  const std::vector<ApngFrame>& Frames() const { return frames_; }
+
+  // 按顺序解码并合成每一帧，onFrame 收到 8 位 BGRA 画布（只在调用期间有效）
+  // 与该帧的显示时长；onFrame 返回 false 时停止。threads 为并行解压的帧数
+  bool ReadFrames(
+      int threads,
+      const std::function<bool(const cv::Mat& canvas, int delayMs)>& onFrame);
+
+ private:
+  bool DecodeFrame(const ApngFrame& frame, cv::Mat& output) const;
+
+  const std::vector<uchar>& data_;
+  cv::Size canvas_;
+  int loops_ = 0;
+  std::string ihdr_;    // IHDR 中尺寸之后的 5 个字节
+  std::string shared_;  // 首个 IDAT 之前、各帧共用的块（PLTE、tRNS 等）
+  std::vector<ApngFrame> frames_;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// 归档中的一个文件
+struct ArchiveEntry {
+  std::string name;         // 归档内的路径（以 / 分隔）
+  uint64_t offset = 0;      // 数据在归档文件中的偏移
+  uint64_t storedSize = 0;  // 归档中的数据大小（压缩后）
+  uint64_t size = 0;        // 解压后的大小
+  int method = 0;           // 0 = 不压缩，8 = deflate
+  uint32_t crc = 0;         // zip 中记录的 CRC-32（tar 不校验）
+  bool checkCrc = false;
+};
+
+// 只读方式内存映射 zip 或 tar 文件并列出其中的文件，不解压到磁盘。
+// 打开后 Extract 可被多个线程同时调用
+class ArchiveReader {
+ public:
+  ArchiveReader() = default;
+  ~ArchiveReader();
+
+  ArchiveReader(const ArchiveReader&) = delete;
+  ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+  // 映射文件并读取目录（zip 中央目录或 tar 头），格式由文件内容判断
+  bool Open(const std::string& path);
+
+  // 归档中的普通文件（不含目录、加密或不支持压缩方式的条目）
+  const std::vector<ArchiveEntry>& Entries() const { return entries_; }
+
+  // 将一个条目解压到 data，zip 条目同时校验 CRC
+  bool Extract(const ArchiveEntry& entry, std::vector<uchar>& data) const;
+
+  // 路径是否指向可作为批量输入的归档（.zip / .tar）
+  static bool IsArchivePath(const std::string& path);
+
+ private:
+  bool ReadZipDirectory();
+  bool ReadTarHeaders();
+
+  std::string path_;
+  const uchar* data_ = nullptr;
+  size_t size_ = 0;
+  void* mapping_ = nullptr;  // windows 的映射句柄
+  std::vector<ArchiveEntry> entries_;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "output_sink.h"
+
+namespace anysticker {
+
+enum class ArchiveFormat { TAR, ZIP };
+
+// 将整批输出顺序追加到一个 tar 或不压缩的 zip 文件中，不为每个贴纸创建文件。
+// 编码完成的数据进入队列，由单独的写入线程依次写出
+class ArchiveSink : public OutputSink {
+ public:
+  // root 为输出目录，归档内的文件名是输出路径相对 root 的路径；
+  // 扩展名为 .zip 时写 zip，否则写 tar
+  ArchiveSink(const std::string& archivePath, const std::string& root);
+  ~ArchiveSink() override;
+
+  ArchiveSink(const ArchiveSink&) = delete;
+  ArchiveSink& operator=(const ArchiveSink&) = delete;
+
+  // 创建归档文件并启动写入线程
+  bool Open();
+
+  bool Write(const std::string& path, const std::vector<uchar>& data) override;
+
+  // 归档中总是写入文件内容，hardLink 不起作用
+  bool CopyFrom(const std::string& sourcePath, const std::string& path,
+                bool hardLink) override;
+
+  // 等待队列写完，写入归档尾部（zip 中央目录）并关闭文件
+  bool Finish() override;
+
+  std::set<std::string> Failed() const override;
+
+  bool DefersCommit() const override;
+
+  static ArchiveFormat FormatFor(const std::string& archivePath);
+
+ private:
+  struct Entry {
+    std::string path;
+    std::string name;
+    std::vector<uchar> data;
+  };
+
+  // zip 中央目录需要的信息
+  struct ZipRecord {
+    std::string name;
+    uint32_t crc;
+    uint32_t size;
+    uint64_t offset;
+  };
+
+  void WriterLoop();
+  bool WriteEntry(const Entry& entry);
+  bool WriteTarEntry(const Entry& entry);
+  bool WriteZipEntry(const Entry& entry);
+  bool WriteTrailer();
+  bool Append(const void* data, size_t size);
+
+  std::string archivePath_;
+  std::string root_;
+  ArchiveFormat format_;
+  FILE* file_ = nullptr;
+  uint64_t offset_ = 0;
+  bool ioError_ = false;
+  uint16_t dosTime_ = 0;
+  uint16_t dosDate_ = 0;
+  std::vector<ZipRecord> zipRecords_;
+  std::vector<std::string> written_;
+
+  std::thread writer_;
+  mutable std::mutex mutex_;
+  std::condition_variable queueReady_;
+  std::condition_variable queueDrained_;
+  std::deque<Entry> queue_;
+  size_t queuedBytes_ = 0;
+  bool closing_ = false;
+  bool finished_ = false;
+  std::set<std::string> failed_;
+};
+
+}  // namespace anysticker
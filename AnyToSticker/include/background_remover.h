@@ -0,0 +1,19 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace anysticker {
+
+// 背景去除参数
+struct BackgroundSettings {
+  int tolerance = 40;     // 与估计背景色的最大颜色距离（RGB 欧氏距离）
+  int featherRadius = 1;  // 前景边缘羽化半径（像素），0 表示不羽化
+};
+
+// 去除与图片边缘相连的纯色背景：由边框像素估计背景色，从边缘做带容差的
+// 扫描线填充，再羽化前景边缘的 alpha。输入为 8 位 BGRA（通常是缩小后的
+// 图片），返回新图片；边框大多已透明时视为无需处理，原样返回
+cv::Mat RemoveBackground(const cv::Mat& bgra,
+                         const BackgroundSettings& settings);
+
+}  // namespace anysticker
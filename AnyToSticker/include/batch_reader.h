@@ -0,0 +1,74 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace anysticker {
+
+// 批量模式读取输入文件的方式
+enum class IoEngine {
+  SYNC,     // 处理线程自己按路径读取
+  THREADS,  // 读取线程池提前读入内存
+  URING     // io_uring 一次提交多个读取（需定义 ANYSTICKER_WITH_IO_URING
+            // 并链接 liburing，不可用时退回线程池）
+};
+
+// 一次读入整个文件；文件为空、超过 maxBytes 或读取失败时返回 false
+bool ReadWholeFile(const std::filesystem::path& path, size_t maxBytes,
+                   std::vector<uchar>& data);
+
+// 批量模式的输入预读：在解码线程之前保持最多 window 个文件的读取窗口，
+// 文件按列表顺序读入内存，解码时不再阻塞于 open/read/close
+class BatchReader {
+ public:
+  // 超过 maxFileBytes 的文件不预读（如需流式处理的超大 PNG）
+  BatchReader(const std::vector<std::filesystem::path>& files, size_t window,
+              size_t maxFileBytes);
+  ~BatchReader();
+
+  BatchReader(const BatchReader&) = delete;
+  BatchReader& operator=(const BatchReader&) = delete;
+
+  // 启动后台读取，返回实际使用的引擎
+  IoEngine Start(IoEngine engine, int threads);
+
+  // 等待第 index 个文件读完并取走内容。文件过大或读取失败时返回 false，
+  // 由调用方按路径读取
+  bool Take(size_t index, std::vector<uchar>& data);
+
+ private:
+  enum class SlotState { QUEUED, READY, SKIPPED };
+
+  struct Slot {
+    SlotState state = SlotState::QUEUED;
+    std::vector<uchar> data;
+  };
+
+  // 等到 index 进入读取窗口，停止时返回 false
+  bool WaitForWindow(size_t index);
+  void Complete(size_t index, bool ok, std::vector<uchar> data);
+  void PoolLoop();
+  bool StartUring();
+  void UringLoop();
+
+  const std::vector<std::filesystem::path>& files_;
+  size_t window_;
+  size_t maxFileBytes_;
+  std::vector<Slot> slots_;
+  std::atomic<size_t> next_{0};
+  size_t taken_ = 0;
+  bool stopping_ = false;
+  void* ring_ = nullptr;
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  std::condition_variable windowOpen_;
+};
+
+}  // namespace anysticker
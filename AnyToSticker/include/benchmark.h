@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "image_processor.h"
+
+namespace anysticker {
+
+// 单个滤波器的测试结果
+struct FilterBenchmark {
+  ResizeFilter filter = ResizeFilter::LANCZOS4;
+  double megapixelsPerSecond = 0;  // 每秒处理的源图像百万像素数
+  double psnr = 0;                 // 与参考图相比的平均 PSNR (dB)
+  double ssim = 0;                 // 与参考图相比的平均 SSIM
+};
+
+// 在图片集（单个文件或目录）上测试所有滤波器的速度与质量，
+// 参考图为抗锯齿 Lanczos3（滤波器按缩放比例展宽）
+std::vector<FilterBenchmark> RunResizeBenchmark(
+    const std::string& inputPath, const ProcessingOptions& options);
+
+// 以表格形式输出测试结果
+void PrintBenchmark(const std::vector<FilterBenchmark>& results);
+
+// 计算两张同尺寸图片的平均 SSIM（11x11 高斯窗口，各通道取平均）
+double ComputeSsim(const cv::Mat& a, const cv::Mat& b);
+
+}  // namespace anysticker
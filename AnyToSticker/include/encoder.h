@@ -0,0 +1,30 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "image_processor.h"
+
+namespace anysticker {
+
+// Telegram 静态贴纸的文件大小上限
+constexpr size_t kTelegramStickerLimit = 512 * 1024;
+
+// 编码统计信息
+struct EncodeStats {
+  size_t bytes = 0;     // 最终输出大小
+  int passes = 0;       // 实际编码次数
+  int quality = 0;      // 最终使用的 WEBP 质量
+  bool lossless = false;  // 最终是否为无损编码
+  int colors = 0;         // PNG 调色板颜色数上限，0 表示真彩色
+  bool withinBudget = true;
+};
+
+// 将图片编码到内存（WEBP 使用 libwebp 直接编码）。
+// options.sizeBudget > 0 时根据大小预测搜索 WEBP 质量
+// （必要时从无损退回有损），通常一到两次编码即可满足上限；
+// PNG 超出上限时改为调色板 PNG 并逐步减少颜色数
+bool EncodeImage(const cv::Mat& image, const ProcessingOptions& options,
+                 std::vector<uchar>& buffer, EncodeStats& stats);
+
+}  // namespace anysticker
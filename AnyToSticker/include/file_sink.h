@@ -0,0 +1,55 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "output_sink.h"
+
+namespace anysticker {
+
+// 输出文件写入器：整个缓冲区一次写入同目录下的临时文件后原子重命名，
+// 失败时不会留下不完整的文件。durable 为 true 时重命名前先 fsync，
+// 保证断电后也不会出现空文件；syncBatch > 1 时累计多个文件后统一 fsync
+// 并重命名（批量模式），减少同步次数。可被多个线程同时使用
+class FileSink : public OutputSink {
+ public:
+  explicit FileSink(bool durable = false, size_t syncBatch = 1);
+  ~FileSink() override;
+
+  FileSink(const FileSink&) = delete;
+  FileSink& operator=(const FileSink&) = delete;
+
+  // 写入 path。durable 的批量模式下文件在下一次统一提交后才可见
+  bool Write(const std::string& path, const std::vector<uchar>& data) override;
+
+  bool CopyFrom(const std::string& sourcePath, const std::string& path,
+                bool hardLink) override;
+
+  // 提交所有尚未提交的文件，之后仍可继续写入
+  bool Finish() override;
+
+  std::set<std::string> Failed() const override;
+
+  bool DefersCommit() const override;
+
+ private:
+  struct Pending {
+    std::string tempPath;
+    std::string path;
+    int fd;  // -1 表示无需同步（硬链接）
+  };
+
+  // 将已写好的临时文件加入待提交队列，必要时提交一组
+  bool Enqueue(Pending entry);
+  bool Commit(std::vector<Pending>& group);
+
+  bool durable_;
+  size_t syncBatch_;
+  mutable std::mutex mutex_;
+  std::vector<Pending> pending_;
+  std::set<std::string> failed_;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+enum class ImageFormat { UNKNOWN, PNG, JPEG, GIF, WEBP, BMP, TIFF };
+
+// 按文件内容识别的输入格式
+struct InputFormat {
+  ImageFormat format = ImageFormat::UNKNOWN;
+  bool animated = false;  // 走动图路径（GIF 总是使用 giflib 读取）
+};
+
+// 文件开头读取的字节数，足以覆盖所有格式的判断
+constexpr size_t kSniffBytes = 4096;
+
+// 由文件开头的字节（魔数）识别格式，与扩展名无关
+InputFormat SniffFormat(const uchar* data, size_t size);
+
+inline InputFormat SniffFormat(const std::vector<uchar>& data) {
+  return SniffFormat(data.data(), data.size());
+}
+
+// 读取文件开头的 kSniffBytes 字节识别格式，用于未整体读入内存的文件；
+// PNG 还会逐个读取 IDAT 之前的块头查找 acTL
+InputFormat SniffFile(const std::string& path);
+
+// 格式名称（用于日志）
+const char* FormatName(ImageFormat format);
+
+}  // namespace anysticker
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "image_processor.h"
+
+namespace anysticker {
+
+// 任务清单中的一项
+struct Job {
+  size_t line = 0;             // 在清单中的行号（从 1 开始）
+  std::string inputPath;
+  std::string outputPath;      // 为空时输出到 -o 目录下的同名文件
+  ProcessingOptions options;   // 应用该行覆盖项之后的参数
+  std::string error;           // 该行无法解析时的原因
+};
+
+// NDJSON 任务清单：每行一个 JSON 对象，包含 input、可选的 output 以及
+// 参数覆盖项（format, quality, budget, quantize, dither, trim, remove_bg,
+// bg_tolerance, bg_feather, filter, linear, passthrough, animated）。
+// 逐行读取，不整体载入内存；可被多个线程同时调用 Next
+class JobManifest {
+ public:
+  JobManifest(const std::string& path, const ProcessingOptions& defaults);
+
+  bool Open();
+
+  // 取出下一项（跳过空行），清单读完时返回 false
+  bool Next(Job& job);
+
+ private:
+  std::string path_;
+  ProcessingOptions defaults_;
+  std::ifstream file_;
+  size_t line_ = 0;
+  std::mutex mutex_;
+};
+
+}  // namespace anysticker
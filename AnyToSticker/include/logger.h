@@ -0,0 +1,53 @@
+#pragma once
+
+#include <optional>
+#include <ostream>
+#include <sstream>
+
+namespace anysticker {
+
+// 日志级别，Error 与 Warning 写入 stderr，其余写入 stdout。
+// 不使用全大写名称：windows.h 会把 ERROR 定义为宏
+enum class LogLevel { Error, Warning, Info, Debug };
+
+// 日志的全局设置。各线程的日志先写入自己的缓冲区，再整批交给唯一的
+// 输出线程写到终端，处理图片的线程不会等待终端 I/O，并行处理时同一文件
+// 的日志也不会与其他文件交错
+class Logger {
+ public:
+  // 输出该级别及更重要的日志（默认 Info；--quiet 为 Warning，-v 为 Debug）
+  static void SetLevel(LogLevel level);
+  static bool Enabled(LogLevel level);
+
+  // 将当前线程缓冲的日志交给输出线程，处理完一个文件后调用
+  static void FlushThread();
+
+  // 交出当前线程的日志并等待全部日志写出，在直接写 stdout 之前与退出前调用
+  static void Flush();
+};
+
+// 一行日志，级别未启用时不做格式化；内容直接格式化到当前线程的缓冲区，
+// 析构时自动换行：
+//   Log(LogLevel::Info) << "Processing " << name;
+class Log {
+ public:
+  explicit Log(LogLevel level);
+  ~Log();
+
+  Log(const Log&) = delete;
+  Log& operator=(const Log&) = delete;
+
+  template <typename T>
+  Log& operator<<(const T& value) {
+    if (stream_) *stream_ << value;
+    return *this;
+  }
+
+ private:
+  LogLevel level_;
+  std::ostream* stream_ = nullptr;  // 未启用时为空
+  // 格式化参数时又写日志的情况少见，这一行单独格式化，排在外层那行之后
+  std::optional<std::ostringstream> nested_;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// 批量模式的输出目标：逐个文件落盘（FileSink）或写入单个归档（ArchiveSink）。
+// 实现需支持多个线程同时调用 Write
+class OutputSink {
+ public:
+  virtual ~OutputSink() = default;
+
+  // 写入一个完整的输出文件，path 为其在输出目录中的路径
+  virtual bool Write(const std::string& path,
+                     const std::vector<uchar>& data) = 0;
+
+  // 原样输出已有文件（无需重新编码的输入）。hardLink 为 true 时
+  // 尽量使用硬链接，否则复制（支持时使用 reflink / copy_file_range）
+  virtual bool CopyFrom(const std::string& sourcePath, const std::string& path,
+                        bool hardLink) = 0;
+
+  // 提交所有已写入的输出，全部成功时返回 true
+  virtual bool Finish() = 0;
+
+  // 提交失败的输出路径
+  virtual std::set<std::string> Failed() const = 0;
+
+  // Write 成功返回后输出是否可能仍未提交（之后仍可能出现在 Failed 中）
+  virtual bool DefersCommit() const = 0;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace anysticker {
+
+// 将解码结果统一为 8 位 BGRA：BGR 补不透明 alpha，灰度与灰度+alpha 展开，
+// 16 位与浮点图片缩放到 8 位，均在一次遍历中完成。
+// 输入已是 8 位 BGRA 时 output 直接引用输入，不复制
+bool ConvertToBgra(const cv::Mat& input, cv::Mat& output);
+
+// 同上，但结果写入按线程复用的缓冲区，只在同一线程下一次调用前有效
+cv::Mat ConvertToBgraPooled(const cv::Mat& input);
+
+}  // namespace anysticker
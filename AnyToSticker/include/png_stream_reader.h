@@ -0,0 +1,54 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// 基于 libpng 的逐行 PNG 读取器，用于超大图片的流式处理，
+// 峰值内存只与行宽有关，与图片高度无关
+class PngStreamReader {
+ public:
+  // data 不为空时从已读入内存的文件内容解码，不再打开 path
+  explicit PngStreamReader(const std::string& path,
+                           const std::vector<uchar>* data = nullptr);
+  ~PngStreamReader();
+
+  PngStreamReader(const PngStreamReader&) = delete;
+  PngStreamReader& operator=(const PngStreamReader&) = delete;
+
+  // 读取文件头并设置像素格式转换，不是 PNG 或无法读取时返回 false
+  bool Open();
+
+  // 是否可以逐行读取（非隔行扫描、位深不超过 8）
+  bool IsStreamable() const { return streamable_; }
+
+  int Width() const { return width_; }
+  int Height() const { return height_; }
+
+  // 输出通道数：灰度图为 1，其余统一为 BGRA，与 cv::imread 后的处理结果一致
+  int Channels() const { return channels_; }
+
+  // 读取下一行到 row（至少 Width() * Channels() 字节）
+  bool ReadRow(uchar* row);
+
+ private:
+  // 从内存中的文件内容读取 size 字节
+  bool ReadMemory(uchar* out, size_t size);
+
+  std::string path_;
+  const std::vector<uchar>* data_ = nullptr;
+  size_t offset_ = 0;  // 从内存读取时的位置
+  FILE* file_ = nullptr;
+  void* png_ = nullptr;
+  void* info_ = nullptr;
+
+  int width_ = 0;
+  int height_ = 0;
+  int channels_ = 0;
+  bool streamable_ = false;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace anysticker {
+
+// PNG 编码器：扫描行过滤后按块并行压缩（pigz 方式），每块以 full flush 结束，
+// 拼接成一个标准 zlib 数据流写入 IDAT，输出仍是普通 PNG。
+// 支持 8 位灰度、BGR、BGRA 图片
+bool EncodePng(const cv::Mat& image, int level, int threads,
+               std::vector<uchar>& buffer);
+
+// 编码 8 位调色板 PNG：indices 为 CV_8UC1 调色板下标，palette 为 BGRA 颜色，
+// 含透明颜色时写入 tRNS（透明颜色应排在调色板前部）
+bool EncodeIndexedPng(const cv::Mat& indices,
+                      const std::vector<cv::Vec4b>& palette, int level,
+                      int threads, std::vector<uchar>& buffer);
+
+}  // namespace anysticker
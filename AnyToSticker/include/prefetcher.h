@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+namespace anysticker {
+
+// 批量模式的页缓存预热：处理当前文件时对其后 aheadBytes 字节以内的输入
+// 发出 WILLNEED 预读提示，处理完的输入发出 DONTNEED，一次性读取的数据
+// 不会挤掉其他缓存。没有 posix_fadvise 的平台（Windows）上不做任何事。
+// 可被多个线程同时使用
+class Prefetcher {
+ public:
+  Prefetcher(const std::vector<std::filesystem::path>& files,
+             size_t aheadBytes);
+
+  // 第 index 个文件开始处理
+  void Started(size_t index);
+
+  // 第 index 个文件处理完毕，其页缓存可以丢弃
+  void Finished(size_t index);
+
+ private:
+  // 在预读字节数允许的范围内继续提示后面的文件，index 本身总会被提示
+  void HintAhead(size_t index);
+
+  const std::vector<std::filesystem::path>& files_;
+  size_t aheadBytes_;
+  std::vector<uintmax_t> sizes_;  // 已提示文件的大小
+  size_t hinted_ = 0;             // 下一个尚未提示的文件
+  uintmax_t pendingBytes_ = 0;    // 已提示但尚未处理完的字节数
+  std::mutex mutex_;
+};
+
+}  // namespace anysticker
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// 处理流程中被计时的阶段
+enum class Stage {
+  READ,        // 读取输入文件
+  DECODE,      // 解码（含流式解码与缩放）
+  CONVERT,     // 转为 8 位 BGRA
+  TRIM,        // 裁掉透明边框
+  RESIZE,      // 缩放
+  BACKGROUND,  // 去除背景
+  ENCODE,      // 编码
+  WRITE,       // 写入输出（含批量 fsync）
+  TOTAL,       // 单个输入的全部处理时间
+  COUNT
+};
+
+// 单个输入在各阶段的累计耗时（毫秒），以 Stage 为下标
+using StageTimes = std::array<double, static_cast<size_t>(Stage::COUNT)>;
+
+// 一个阶段的统计结果，时间单位为毫秒
+struct StageStats {
+  Stage stage = Stage::READ;
+  size_t count = 0;
+  double totalMs = 0;
+  double p50Ms = 0;
+  double p95Ms = 0;
+  double p99Ms = 0;
+  double maxMs = 0;
+};
+
+// --profile 与 --report 使用的阶段计时。每个线程把耗时记录在自己的缓冲区
+// 中，不加锁；线程结束时并入全局结果。未启用时计时点只有一次判断
+class Profiler {
+ public:
+  // 在启动工作线程之前调用
+  static void Enable();
+  static bool Enabled();
+
+  // 记录当前线程一次阶段耗时
+  static void Record(Stage stage, std::chrono::nanoseconds duration);
+
+  // 开始累计当前线程上一个输入的各阶段耗时；嵌套调用并入最外层的输入
+  static void BeginInput();
+
+  // 结束一层输入计时，返回自最外层 BeginInput 以来的累计耗时
+  static StageTimes EndInput();
+
+  // 将辅助线程为当前输入花费的时间计入当前线程的输入累计。
+  // 辅助线程已自行记录到全局统计，这里不重复记录
+  static void AddInputTime(Stage stage, std::chrono::nanoseconds duration);
+
+  // 汇总所有线程的记录，应在工作线程结束后调用；没有记录的阶段不列出
+  static std::vector<StageStats> Collect();
+
+  // 以表格形式输出统计结果，wallSeconds 为整个运行的时间
+  static void PrintReport(const std::vector<StageStats>& stats,
+                          double wallSeconds);
+
+  // 将统计结果写入 JSON 文件
+  static bool WriteJson(const std::string& path,
+                        const std::vector<StageStats>& stats,
+                        double wallSeconds);
+
+  static const char* StageName(Stage stage);
+};
+
+// 在作用域内为一个阶段计时
+class ScopedStage {
+ public:
+  explicit ScopedStage(Stage stage)
+      : stage_(stage), active_(Profiler::Enabled()) {
+    if (active_) start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedStage() {
+    if (active_) {
+      Profiler::Record(stage_, std::chrono::steady_clock::now() - start_);
+    }
+  }
+
+  ScopedStage(const ScopedStage&) = delete;
+  ScopedStage& operator=(const ScopedStage&) = delete;
+
+ private:
+  Stage stage_;
+  bool active_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+}  // namespace anysticker
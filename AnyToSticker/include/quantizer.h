@@ -0,0 +1,21 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+namespace anysticker {
+
+// 调色板图片：indices 为 CV_8UC1 调色板下标，palette 为 BGRA 颜色，
+// 含透明度的颜色排在前面，以缩短 PNG 的 tRNS 块
+struct PaletteImage {
+  cv::Mat indices;
+  std::vector<cv::Vec4b> palette;
+};
+
+// 将 8 位 BGR/BGRA 图片转换为最多 maxColors 色的调色板图片。
+// 颜色数不超过 maxColors 时直接精确映射（无损）；否则使用中位切分加
+// k-means 生成调色板，dither 为 true 时使用 Floyd-Steinberg 抖动
+bool QuantizeImage(const cv::Mat& image, int maxColors, bool dither,
+                   PaletteImage& result);
+
+}  // namespace anysticker
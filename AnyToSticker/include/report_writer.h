@@ -0,0 +1,33 @@
+#pragma once
+
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include "image_processor.h"
+
+namespace anysticker {
+
+// --report 的逐文件报告（NDJSON）：每个输入一行 JSON 并立即刷新，运行中途
+// 即可读取已完成的记录。每个输入只有一条记录；输出延迟提交时（归档、
+// 批量 fsync）记录在提交后统一写出。可由多个工作线程同时调用
+class ReportWriter {
+ public:
+  explicit ReportWriter(const std::string& path);
+
+  // 创建（或清空）报告文件
+  bool Open();
+
+  // 写出一条记录
+  bool Write(const ProcessingResult& result);
+
+ private:
+  std::string path_;
+  std::mutex mutex_;
+  std::ofstream file_;
+};
+
+// 一条记录的 JSON 对象（不含换行）
+std::string FormatReportRecord(const ProcessingResult& result);
+
+}  // namespace anysticker
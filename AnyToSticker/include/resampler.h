@@ -0,0 +1,96 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+
+// 重采样滤波器：AREA 对源像素按覆盖面积取平均，
+// 其余滤波器与 cv::resize 一样在源图分辨率上按固定点数采样
+enum class ResizeFilter {
+  AREA,
+  BILINEAR,
+  BICUBIC,
+  LANCZOS3,
+  LANCZOS4,
+  MITCHELL
+};
+
+// 滤波器名称（area, bilinear, bicubic, lanczos3, lanczos4, mitchell）
+const char* ResizeFilterName(ResizeFilter filter);
+bool ParseResizeFilter(const std::string& name, ResizeFilter& filter);
+
+struct ResampleSettings {
+  ResizeFilter filter = ResizeFilter::LANCZOS4;
+  bool linearLight = false;  // 转换到线性光再重采样（alpha 通道除外）
+  bool antialias = false;    // 缩小时按缩放比例展宽滤波器（较慢，用于参考图）
+};
+
+// 单个方向上的重采样系数表
+struct ResampleAxis {
+  int taps = 0;                // 每个输出像素使用的源像素个数
+  std::vector<int> index;      // 源像素下标（已按边界复制截断），taps 个一组
+  std::vector<float> weight;   // 对应权重，taps 个一组
+  std::vector<int> first;      // 每个输出像素所需的第一个源像素
+  std::vector<int> last;       // 每个输出像素所需的最后一个源像素
+
+  static ResampleAxis Build(int srcLength, int dstLength,
+                            const ResampleSettings& settings);
+};
+
+// 可分离重采样器：先水平后垂直，垂直方向使用滚动窗口，
+// 因此既可以整图缩放，也可以逐行输入源图像（流式缩放）且结果完全一致。
+// 整图缩放时按输出行分段并行，相邻分段共享的源行（halo）各自计算一次。
+// 线性光模式通过查找表完成 sRGB 与线性光之间的转换
+class Resampler {
+ public:
+  Resampler(cv::Size srcSize, cv::Size dstSize, int channels,
+            const ResampleSettings& settings = ResampleSettings());
+
+  // 整图缩放（仅支持 8 位图像），按输出行分为最多 threads 段，每段一个线程；
+  // threads <= 0 时使用 cv::getNumThreads()
+  static cv::Mat Resize(const cv::Mat& input, cv::Size dstSize,
+                        const ResampleSettings& settings = ResampleSettings(),
+                        int threads = 0);
+
+  // 按顺序输入下一行源像素
+  void PushRow(const uchar* row);
+
+  // 所有输出行是否已经生成
+  bool Done() const { return nextDstRow_ >= dstSize_.height; }
+
+  const cv::Mat& Output() const { return output_; }
+
+ private:
+  // 水平缩放源行 y 放入环形缓冲区，并输出 [nextDst, dstEnd) 中已就绪的行
+  void FeedRow(int y, const uchar* row, float* window, int& nextDst,
+               int dstEnd);
+
+  // 处理输出行 [dstBegin, dstEnd) 所需的全部源行，使用独立的环形缓冲区
+  void ResizeBand(const cv::Mat& input, int dstBegin, int dstEnd);
+
+  // Linear 为 true 时在读取 8 位源像素时查表转换到线性光
+  template <typename T, bool Linear>
+  void HorizontalPass(const T* src, float* dst) const;
+  void VerticalPass(int dstRow, const float* window, uchar* dst) const;
+
+  cv::Size srcSize_;
+  cv::Size dstSize_;
+  int channels_;
+  bool linearLight_;
+  int alphaChannel_;  // alpha 通道下标，没有 alpha 时为 -1
+  ResampleAxis xAxis_;
+  ResampleAxis yAxis_;
+
+  // 水平缩放后的源行环形缓冲区，按源行号取模存放
+  int windowRows_ = 0;
+  std::vector<float> window_;
+  std::vector<char> rowNeeded_;
+
+  int nextSrcRow_ = 0;
+  int nextDstRow_ = 0;
+  cv::Mat output_;
+};
+
+}  // namespace anysticker
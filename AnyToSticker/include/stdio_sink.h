@@ -0,0 +1,41 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "output_sink.h"
+
+namespace anysticker {
+
+// 命令行中表示标准输入 / 标准输出的路径
+constexpr const char* kStdioPath = "-";
+
+// 将输出写到标准输出（二进制模式），用于 shell 管道。
+// 只能写出一个文件，path 仅用于错误信息
+class StdoutSink : public OutputSink {
+ public:
+  StdoutSink();
+
+  bool Write(const std::string& path, const std::vector<uchar>& data) override;
+
+  bool CopyFrom(const std::string& sourcePath, const std::string& path,
+                bool hardLink) override;
+
+  bool Finish() override;
+
+  std::set<std::string> Failed() const override;
+
+  bool DefersCommit() const override;
+
+ private:
+  mutable std::mutex mutex_;
+  bool written_ = false;
+  std::set<std::string> failed_;
+};
+
+// 以二进制模式读入全部标准输入
+bool ReadStdin(std::vector<uchar>& data);
+
+}  // namespace anysticker
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+namespace anysticker {
+
+// 8 位 BGRA 图片中 alpha 不为 0 的最小包围矩形，完全透明时返回空矩形。
+// 上下边界逐行扫描、遇到第一行非透明像素即停止；左右边界只检查尚未
+// 确定为内容的列
+cv::Rect FindAlphaBounds(const cv::Mat& bgra);
+
+// 裁掉透明边框，返回原图的 ROI（不复制像素）；非 BGRA 或完全透明时原样返回
+cv::Mat TrimTransparent(const cv::Mat& bgra);
+
+}  // namespace anysticker
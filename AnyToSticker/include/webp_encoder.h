@@ -0,0 +1,40 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+#include "image_processor.h"
+
+namespace anysticker {
+
+// 直接调用 libwebp 编码。BGRA 图片在安全时直接作为 ARGB 缓冲区传入（不复制），
+// 编码器配置与输出写入器按线程复用；lossless 为 true 时 quality 表示压缩力度
+bool EncodeWebp(const cv::Mat& image, const WebpOptions& webp, int quality,
+                bool lossless, std::vector<uchar>& buffer);
+
+// 逐帧编码动态 WEBP（libwebp 的 WebPAnimEncoder），帧之间只保存变化区域
+class AnimatedWebpEncoder {
+ public:
+  // loopCount 为 0 时无限循环
+  AnimatedWebpEncoder(cv::Size size, const WebpOptions& webp, int quality,
+                      bool lossless, int loopCount);
+  ~AnimatedWebpEncoder();
+
+  AnimatedWebpEncoder(const AnimatedWebpEncoder&) = delete;
+  AnimatedWebpEncoder& operator=(const AnimatedWebpEncoder&) = delete;
+
+  // 添加一帧 8 位 BGRA 图片，timestampMs 为该帧开始显示的时间
+  bool AddFrame(const cv::Mat& frame, int timestampMs);
+
+  // 结束编码，endTimestampMs 为最后一帧结束的时间
+  bool Finish(int endTimestampMs, std::vector<uchar>& buffer);
+
+ private:
+  void* encoder_ = nullptr;
+  cv::Size size_;
+  WebpOptions webp_;
+  int quality_;
+  bool lossless_;
+};
+
+}  // namespace anysticker
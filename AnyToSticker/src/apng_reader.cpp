@@ -0,0 +1,264 @@
+#include "../include/apng_reader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <opencv2/imgcodecs.hpp>
+#include <thread>
+
+#include "../include/logger.h"
+#include "../include/pixel_format.h"
+#include "../include/profiler.h"
+
+namespace anysticker {
+
+namespace {
+
+const uchar kPngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+uint32_t ReadBe32(const uchar* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) |
+         p[3];
+}
+
+uint16_t ReadBe16(const uchar* p) {
+  return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+void AppendBe32(std::vector<uchar>& out, uint32_t value) {
+  out.push_back(static_cast<uchar>(value >> 24));
+  out.push_back(static_cast<uchar>(value >> 16));
+  out.push_back(static_cast<uchar>(value >> 8));
+  out.push_back(static_cast<uchar>(value));
+}
+
+void AppendChunk(std::vector<uchar>& out, const char* type, const uchar* data,
+                 size_t size) {
+  AppendBe32(out, static_cast<uint32_t>(size));
+  size_t start = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  AppendBe32(out, static_cast<uint32_t>(
+                      crc32(0, out.data() + start,
+                            static_cast<uInt>(out.size() - start))));
+}
+
+// non-premultiplied "over" as the APNG spec defines it
+void BlendOver(const cv::Mat& source, cv::Mat& target) {
+  for (int y = 0; y < source.rows; ++y) {
+    const uchar* s = source.ptr(y);
+    uchar* d = target.ptr(y);
+    for (int x = 0; x < source.cols; ++x, s += 4, d += 4) {
+      int sa = s[3];
+      if (sa == 255) {
+        memcpy(d, s, 4);
+      } else if (sa > 0) {
+        int da = d[3] * (255 - sa);
+        int alpha = sa * 255 + da;
+        for (int c = 0; c < 3; ++c) {
+          d[c] = static_cast<uchar>((s[c] * sa * 255 + d[c] * da + alpha / 2) /
+                                    alpha);
+        }
+        d[3] = static_cast<uchar>((alpha + 127) / 255);
+      }
+    }
+  }
+}
+
+void CopyRows(const cv::Mat& source, cv::Mat& target) {
+  for (int y = 0; y < source.rows; ++y) {
+    memcpy(target.ptr(y), source.ptr(y), static_cast<size_t>(source.cols) * 4);
+  }
+}
+
+}  // namespace
+
+ApngReader::ApngReader(const std::vector<uchar>& data) : data_(data) {}
+
+bool ApngReader::Open() {
+  const uchar* data = data_.data();
+  const size_t size = data_.size();
+  if (size < 8 || memcmp(data, kPngSignature, 8) != 0) return false;
+
+  bool animated = false;
+  bool seenIdat = false;
+  bool idatIsFrame = false;
+  size_t pos = 8;
+  while (pos + 12 <= size) {
+    size_t length = ReadBe32(data + pos);
+    if (length > size - pos - 12) return false;
+    const char* type = reinterpret_cast<const char*>(data + pos + 4);
+    const uchar* body = data + pos + 8;
+
+    if (memcmp(type, "IHDR", 4) == 0) {
+      if (length < 13) return false;
+      uint32_t width = ReadBe32(body);
+      uint32_t height = ReadBe32(body + 4);
+      if (width == 0 || height == 0 || width > INT32_MAX ||
+          height > INT32_MAX) {
+        return false;
+      }
+      canvas_ = cv::Size(static_cast<int>(width), static_cast<int>(height));
+      ihdr_.assign(reinterpret_cast<const char*>(body + 8), 5);
+    } else if (memcmp(type, "acTL", 4) == 0) {
+      if (length < 8) return false;
+      loops_ = static_cast<int>(std::min<uint32_t>(ReadBe32(body + 4),
+                                                   INT32_MAX));
+      animated = true;
+    } else if (memcmp(type, "fcTL", 4) == 0) {
+      if (length < 26) return false;
+      ApngFrame frame;
+      uint32_t width = ReadBe32(body + 4);
+      uint32_t height = ReadBe32(body + 8);
+      uint32_t x = ReadBe32(body + 12);
+      uint32_t y = ReadBe32(body + 16);
+      // a frame has to lie inside the canvas
+      if (width == 0 || height == 0 ||
+          x > static_cast<uint32_t>(canvas_.width) ||
+          y > static_cast<uint32_t>(canvas_.height) ||
+          width > static_cast<uint32_t>(canvas_.width) - x ||
+          height > static_cast<uint32_t>(canvas_.height) - y) {
+        return false;
+      }
+      frame.region = cv::Rect(static_cast<int>(x), static_cast<int>(y),
+                              static_cast<int>(width),
+                              static_cast<int>(height));
+      int numerator = ReadBe16(body + 20);
+      int denominator = ReadBe16(body + 22);
+      if (denominator == 0) denominator = 100;
+      frame.delayMs = numerator * 1000 / denominator;
+      frame.dispose = body[24];
+      frame.blend = body[25];
+      if (frame.dispose > 2 || frame.blend > 1) return false;
+      // there is nothing to restore before the first frame
+      if (frames_.empty() && frame.dispose == 2) frame.dispose = 1;
+      frames_.push_back(frame);
+    } else if (memcmp(type, "IDAT", 4) == 0) {
+      // the default image is only part of the animation when its fcTL
+      // comes first
+      if (!seenIdat) idatIsFrame = !frames_.empty();
+      seenIdat = true;
+      if (idatIsFrame) frames_.back().chunks.emplace_back(pos + 8, length);
+    } else if (memcmp(type, "fdAT", 4) == 0) {
+      if (length < 4 || frames_.empty()) return false;
+      frames_.back().chunks.emplace_back(pos + 12, length - 4);
+    } else if (memcmp(type, "IEND", 4) == 0) {
+      break;
+    } else if (!seenIdat) {
+      // PLTE, tRNS, gAMA and friends apply to every frame
+      shared_.append(reinterpret_cast<const char*>(data + pos), length + 12);
+    }
+    pos += length + 12;
+  }
+
+  if (!animated || ihdr_.empty() || frames_.empty()) return false;
+  for (const ApngFrame& frame : frames_) {
+    if (frame.chunks.empty()) return false;
+  }
+  return true;
+}
+
+bool ApngReader::DecodeFrame(const ApngFrame& frame, cv::Mat& output) const {
+  ScopedStage stage(Stage::DECODE);
+  try {
+    // every frame is rebuilt as a standalone png: the shared header chunks
+    // plus its own data in a single IDAT
+    size_t dataSize = 0;
+    for (const auto& chunk : frame.chunks) dataSize += chunk.second;
+    if (dataSize > INT32_MAX) return false;
+
+    std::vector<uchar> png(kPngSignature, kPngSignature + 8);
+    png.reserve(8 + 25 + shared_.size() + dataSize + 24);
+
+    std::vector<uchar> header;
+    AppendBe32(header, static_cast<uint32_t>(frame.region.width));
+    AppendBe32(header, static_cast<uint32_t>(frame.region.height));
+    header.insert(header.end(), ihdr_.begin(), ihdr_.end());
+    AppendChunk(png, "IHDR", header.data(), header.size());
+    png.insert(png.end(), shared_.begin(), shared_.end());
+
+    AppendBe32(png, static_cast<uint32_t>(dataSize));
+    size_t start = png.size();
+    png.insert(png.end(), {'I', 'D', 'A', 'T'});
+    for (const auto& chunk : frame.chunks) {
+      png.insert(png.end(), data_.begin() + chunk.first,
+                 data_.begin() + chunk.first + chunk.second);
+    }
+    AppendBe32(png, static_cast<uint32_t>(
+                        crc32(0, png.data() + start,
+                              static_cast<uInt>(png.size() - start))));
+    AppendChunk(png, "IEND", nullptr, 0);
+
+    cv::Mat decoded = cv::imdecode(png, cv::IMREAD_UNCHANGED);
+    if (decoded.empty() || !ConvertToBgra(decoded, output)) return false;
+    return output.size() == frame.region.size();
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+bool ApngReader::ReadFrames(
+    int threads,
+    const std::function<bool(const cv::Mat& canvas, int delayMs)>& onFrame) {
+  cv::Mat canvas(canvas_, CV_8UC4, cv::Scalar(0, 0, 0, 0));
+  const size_t batch = static_cast<size_t>(std::max(1, threads));
+
+  for (size_t first = 0; first < frames_.size(); first += batch) {
+    // inflate a batch of frames in parallel, each frame's data is an
+    // independent zlib stream
+    size_t count = std::min(batch, frames_.size() - first);
+    std::vector<cv::Mat> decoded(count);
+    std::vector<char> ok(count, 0);
+    std::vector<std::chrono::nanoseconds> helperTime(count);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; ++i) {
+      workers.emplace_back([&, i] {
+        auto start = std::chrono::steady_clock::now();
+        ok[i] = DecodeFrame(frames_[first + i], decoded[i]);
+        helperTime[i] = std::chrono::steady_clock::now() - start;
+      });
+    }
+    ok[0] = DecodeFrame(frames_[first], decoded[0]);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+    // the helpers time their decodes on their own threads, the input this
+    // thread is working on is credited here so the report includes them
+    for (size_t i = 1; i < count; ++i) {
+      Profiler::AddInputTime(Stage::DECODE, helperTime[i]);
+    }
+
+    // compositing depends on the previous canvas and stays sequential
+    for (size_t i = 0; i < count; ++i) {
+      const ApngFrame& frame = frames_[first + i];
+      if (!ok[i]) {
+        Log(LogLevel::Error) << "Failed to decode apng frame " << first + i;
+        return false;
+      }
+
+      cv::Mat region = canvas(frame.region);
+      cv::Mat saved;
+      if (frame.dispose == 2) saved = region.clone();
+
+      if (frame.blend == 0) {
+        CopyRows(decoded[i], region);
+      } else {
+        BlendOver(decoded[i], region);
+      }
+      decoded[i].release();
+
+      if (!onFrame(canvas, frame.delayMs)) return false;
+
+      if (frame.dispose == 1) {
+        region.setTo(cv::Scalar(0, 0, 0, 0));
+      } else if (frame.dispose == 2) {
+        CopyRows(saved, region);
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace anysticker
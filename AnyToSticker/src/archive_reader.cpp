@@ -0,0 +1,392 @@
+#include "../include/archive_reader.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../include/logger.h"
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+namespace {
+
+// sizes are taken from the archive itself, so a corrupt or hostile entry
+// could otherwise claim any amount of memory. deflate never expands data
+// more than about 1032 times
+constexpr uint64_t kMaxEntryBytes = 512ull * 1024 * 1024;
+constexpr uint64_t kMaxDeflateRatio = 1032;
+
+// whether [offset, offset + length) lies within size bytes. the values come
+// from the archive, so the check is written to never wrap around
+bool InRange(uint64_t offset, uint64_t length, uint64_t size) {
+  return offset <= size && length <= size - offset;
+}
+
+uint16_t ReadLe16(const uchar* p) {
+  return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t ReadLe32(const uchar* p) {
+  return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+         (static_cast<uint32_t>(p[2]) << 16) |
+         (static_cast<uint32_t>(p[3]) << 24);
+}
+
+uint64_t ReadLe64(const uchar* p) {
+  return ReadLe32(p) | (static_cast<uint64_t>(ReadLe32(p + 4)) << 32);
+}
+
+// tar numbers are octal text, or base-256 when the high bit is set
+uint64_t ReadTarNumber(const uchar* p, size_t length) {
+  uint64_t value = 0;
+  if (p[0] & 0x80) {
+    for (size_t i = 1; i < length; ++i) value = (value << 8) | p[i];
+    return value;
+  }
+  for (size_t i = 0; i < length && p[i]; ++i) {
+    if (p[i] >= '0' && p[i] <= '7') value = value * 8 + (p[i] - '0');
+  }
+  return value;
+}
+
+std::string ReadTarString(const uchar* p, size_t length) {
+  const uchar* end = std::find(p, p + length, 0);
+  return std::string(reinterpret_cast<const char*>(p), end - p);
+}
+
+bool IsZeroBlock(const uchar* block) {
+  return std::all_of(block, block + 512, [](uchar c) { return c == 0; });
+}
+
+// the header checksum is the byte sum with the checksum field read as spaces
+bool TarChecksumMatches(const uchar* block) {
+  uint64_t sum = 0;
+  for (int i = 0; i < 512; ++i) {
+    sum += (i >= 148 && i < 156) ? ' ' : block[i];
+  }
+  return sum == ReadTarNumber(block + 148, 8);
+}
+
+// path=... from a pax extended header, records are "<len> key=value\n".
+// parsing stops at the first malformed record
+std::string ReadPaxPath(const uchar* data, size_t size) {
+  std::string path;
+  size_t pos = 0;
+  while (pos < size) {
+    size_t space = pos;
+    while (space < size && data[space] != ' ') ++space;
+    if (space == pos || space == size) break;
+    size_t length = 0;
+    bool valid = true;
+    for (size_t i = pos; i < space && valid; ++i) {
+      valid = data[i] >= '0' && data[i] <= '9';
+      length = length * 10 + (data[i] - '0');
+      valid = valid && length <= size - pos;
+    }
+    // the length covers its own digits, the space and the newline
+    if (!valid || space + 1 >= pos + length) break;
+    std::string record(reinterpret_cast<const char*>(data) + space + 1,
+                       pos + length - space - 2);
+    if (record.compare(0, 5, "path=") == 0) path = record.substr(5);
+    pos += length;
+  }
+  return path;
+}
+
+}  // namespace
+
+ArchiveReader::~ArchiveReader() {
+#ifdef _WIN32
+  if (data_) UnmapViewOfFile(data_);
+  if (mapping_) CloseHandle(static_cast<HANDLE>(mapping_));
+#else
+  if (data_) munmap(const_cast<uchar*>(data_), size_);
+#endif
+}
+
+bool ArchiveReader::IsArchivePath(const std::string& path) {
+  std::string ext = fs::path(path).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  std::error_code error;
+  return (ext == ".zip" || ext == ".tar") && fs::is_regular_file(path, error);
+}
+
+bool ArchiveReader::Open(const std::string& path) {
+  path_ = path;
+
+  // the whole archive is mapped once, entries are then read from memory
+  // without seeking or copying through a file buffer
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                            nullptr);
+  if (file == INVALID_HANDLE_VALUE) return false;
+  LARGE_INTEGER fileSize;
+  if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_) {
+      data_ = static_cast<const uchar*>(
+          MapViewOfFile(static_cast<HANDLE>(mapping_), FILE_MAP_READ, 0, 0, 0));
+    }
+  }
+  CloseHandle(file);
+#else
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    size_ = static_cast<size_t>(info.st_size);
+    void* mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped != MAP_FAILED) {
+      data_ = static_cast<const uchar*>(mapped);
+    }
+  }
+  close(fd);
+#endif
+  if (!data_) {
+    Log(LogLevel::Error) << "Error: cannot map archive " << path;
+    return false;
+  }
+
+  bool ok;
+  if (size_ >= 512 && memcmp(data_ + 257, "ustar", 5) == 0) {
+    ok = ReadTarHeaders();
+  } else {
+    ok = ReadZipDirectory();
+  }
+  if (!ok) {
+    Log(LogLevel::Error) << "Error: " << path
+                         << " is not a readable zip or tar archive";
+  }
+  return ok;
+}
+
+bool ArchiveReader::ReadZipDirectory() {
+  // the end of central directory record sits behind an optional comment of
+  // up to 64 KB
+  if (size_ < 22) return false;
+  size_t eocd = size_ - 22;
+  size_t lowest = size_ > 22 + 0xFFFF ? size_ - 22 - 0xFFFF : 0;
+  while (ReadLe32(data_ + eocd) != 0x06054b50) {
+    if (eocd == lowest) return false;
+    --eocd;
+  }
+
+  uint64_t count = ReadLe16(data_ + eocd + 10);
+  uint64_t directorySize = ReadLe32(data_ + eocd + 12);
+  uint64_t directoryOffset = ReadLe32(data_ + eocd + 16);
+
+  // zip64 keeps the real values in a record found through the locator
+  if ((count == 0xFFFF || directoryOffset == 0xFFFFFFFF) && eocd >= 20 &&
+      ReadLe32(data_ + eocd - 20) == 0x07064b50) {
+    uint64_t record = ReadLe64(data_ + eocd - 20 + 8);
+    if (!InRange(record, 56, size_) ||
+        ReadLe32(data_ + record) != 0x06064b50) {
+      return false;
+    }
+    count = ReadLe64(data_ + record + 32);
+    directorySize = ReadLe64(data_ + record + 40);
+    directoryOffset = ReadLe64(data_ + record + 48);
+  }
+  if (!InRange(directoryOffset, directorySize, size_)) return false;
+
+  size_t pos = static_cast<size_t>(directoryOffset);
+  const size_t end = static_cast<size_t>(directoryOffset + directorySize);
+  for (uint64_t i = 0; i < count; ++i) {
+    if (pos + 46 > end || ReadLe32(data_ + pos) != 0x02014b50) return false;
+    const uchar* header = data_ + pos;
+    uint16_t flags = ReadLe16(header + 8);
+    ArchiveEntry entry;
+    entry.method = ReadLe16(header + 10);
+    entry.crc = ReadLe32(header + 16);
+    entry.checkCrc = true;
+    entry.storedSize = ReadLe32(header + 20);
+    entry.size = ReadLe32(header + 24);
+    size_t nameLength = ReadLe16(header + 28);
+    size_t extraLength = ReadLe16(header + 30);
+    size_t commentLength = ReadLe16(header + 32);
+    uint64_t localOffset = ReadLe32(header + 42);
+    if (pos + 46 + nameLength + extraLength > end) return false;
+    entry.name.assign(reinterpret_cast<const char*>(header + 46), nameLength);
+
+    // zip64 extra field: only the values saturated above are present
+    const uchar* extra = header + 46 + nameLength;
+    for (size_t e = 0; e + 4 <= extraLength;) {
+      uint16_t id = ReadLe16(extra + e);
+      uint16_t length = ReadLe16(extra + e + 2);
+      if (id == 0x0001) {
+        const uchar* field = extra + e + 4;
+        const uchar* fieldEnd = field + std::min<size_t>(length,
+                                                         extraLength - e - 4);
+        auto take = [&](uint64_t& value) {
+          if (value != 0xFFFFFFFF || field + 8 > fieldEnd) return;
+          value = ReadLe64(field);
+          field += 8;
+        };
+        take(entry.size);
+        take(entry.storedSize);
+        take(localOffset);
+      }
+      e += 4 + length;
+    }
+    pos += 46 + nameLength + extraLength + commentLength;
+
+    if (entry.name.empty() || entry.name.back() == '/') continue;
+    if (flags & 1) {
+      Log(LogLevel::Warning) << "Skipping encrypted entry " << entry.name;
+      continue;
+    }
+    if (entry.method != 0 && entry.method != 8) {
+      Log(LogLevel::Warning) << "Skipping " << entry.name
+                             << ", compression method " << entry.method
+                             << " is not supported";
+      continue;
+    }
+
+    // the data follows the local header, whose extra field may differ from
+    // the central one
+    if (!InRange(localOffset, 30, size_) ||
+        ReadLe32(data_ + localOffset) != 0x04034b50) {
+      return false;
+    }
+    const uchar* local = data_ + localOffset;
+    uint64_t localFields = ReadLe16(local + 26) + ReadLe16(local + 28);
+    if (!InRange(localOffset + 30, localFields, size_)) return false;
+    entry.offset = localOffset + 30 + localFields;
+    if (!InRange(entry.offset, entry.storedSize, size_)) return false;
+    entries_.push_back(std::move(entry));
+  }
+  return true;
+}
+
+bool ArchiveReader::ReadTarHeaders() {
+  std::string longName;
+  size_t pos = 0;
+  while (pos + 512 <= size_) {
+    const uchar* header = data_ + pos;
+    if (IsZeroBlock(header)) break;
+    if (!TarChecksumMatches(header)) return false;
+
+    uint64_t size = ReadTarNumber(header + 124, 12);
+    size_t dataOffset = pos + 512;
+    if (!InRange(dataOffset, size, size_)) return false;
+    char type = static_cast<char>(header[156]);
+    pos = dataOffset + static_cast<size_t>((size + 511) / 512 * 512);
+
+    // gnu long names and pax paths apply to the header that follows
+    if (type == 'L') {
+      longName = ReadTarString(data_ + dataOffset, static_cast<size_t>(size));
+      continue;
+    }
+    if (type == 'x') {
+      longName = ReadPaxPath(data_ + dataOffset, static_cast<size_t>(size));
+      continue;
+    }
+
+    std::string name = longName;
+    longName.clear();
+    if (type != '0' && type != '\0' && type != '7') continue;
+    if (name.empty()) {
+      name = ReadTarString(header, 100);
+      std::string prefix = ReadTarString(header + 345, 155);
+      if (!prefix.empty()) name = prefix + "/" + name;
+    }
+    if (name.empty() || name.back() == '/') continue;
+
+    ArchiveEntry entry;
+    entry.name = name;
+    entry.offset = dataOffset;
+    entry.storedSize = size;
+    entry.size = size;
+    entries_.push_back(std::move(entry));
+  }
+  return true;
+}
+
+bool ArchiveReader::Extract(const ArchiveEntry& entry,
+                            std::vector<uchar>& data) const {
+  const uchar* source = data_ + entry.offset;
+  if (entry.method == 0) {
+    data.assign(source, source + entry.storedSize);
+  } else if (entry.size == 0) {
+    data.clear();  // zlib refuses an empty output buffer
+  } else {
+    if (entry.size > kMaxEntryBytes ||
+        entry.size > entry.storedSize * kMaxDeflateRatio) {
+      Log(LogLevel::Error) << "Error: " << entry.name
+                           << " claims an implausible size of " << entry.size
+                           << " bytes";
+      return false;
+    }
+    // raw deflate straight out of the mapping into a buffer of the final
+    // size, large entries are fed to zlib in pieces its counters can hold
+    data.resize(static_cast<size_t>(entry.size));
+    z_stream stream{};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) return false;
+    const uInt kChunk = 1u << 30;
+    uint64_t inputLeft = entry.storedSize;
+    uint64_t outputLeft = entry.size;
+    stream.next_in = const_cast<Bytef*>(source);
+    stream.next_out = data.data();
+    int status = Z_OK;
+    while (status == Z_OK) {
+      if (stream.avail_in == 0 && inputLeft > 0) {
+        stream.avail_in = static_cast<uInt>(std::min<uint64_t>(inputLeft,
+                                                               kChunk));
+        inputLeft -= stream.avail_in;
+      }
+      if (stream.avail_out == 0 && outputLeft > 0) {
+        stream.avail_out = static_cast<uInt>(std::min<uint64_t>(outputLeft,
+                                                                kChunk));
+        outputLeft -= stream.avail_out;
+      }
+      status = inflate(&stream, Z_NO_FLUSH);
+      // out of buffer only counts as an error once nothing is left to refill
+      bool refill = (stream.avail_in == 0 && inputLeft > 0) ||
+                    (stream.avail_out == 0 && outputLeft > 0);
+      if (status == Z_BUF_ERROR && refill) {
+        status = Z_OK;
+      }
+    }
+    bool complete = status == Z_STREAM_END && stream.avail_out == 0 &&
+                    outputLeft == 0;
+    inflateEnd(&stream);
+    if (!complete) {
+      Log(LogLevel::Error) << "Error: cannot inflate " << entry.name;
+      return false;
+    }
+  }
+
+  if (entry.checkCrc) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (size_t done = 0; done < data.size();) {
+      uInt length = static_cast<uInt>(std::min<size_t>(data.size() - done,
+                                                       1u << 30));
+      crc = crc32(crc, data.data() + done, length);
+      done += length;
+    }
+    if (crc != entry.crc) {
+      Log(LogLevel::Error) << "Error: CRC mismatch in " << entry.name;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace anysticker
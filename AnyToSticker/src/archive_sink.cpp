@@ -0,0 +1,377 @@
+#include "../include/archive_sink.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+
+#include "../include/logger.h"
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+namespace {
+
+// encoders block once this much finished output is waiting for the writer
+constexpr size_t kMaxQueuedBytes = 64 * 1024 * 1024;
+
+// large stdio buffer, the archive is written strictly sequentially
+constexpr size_t kWriteBufferBytes = 1024 * 1024;
+
+constexpr size_t kTarBlock = 512;
+
+constexpr uint32_t kZip32Limit = 0xFFFFFFFF;
+constexpr uint16_t kZip16Limit = 0xFFFF;
+
+void PutLe16(std::vector<uchar>& out, uint16_t value) {
+  out.push_back(static_cast<uchar>(value));
+  out.push_back(static_cast<uchar>(value >> 8));
+}
+
+void PutLe32(std::vector<uchar>& out, uint32_t value) {
+  PutLe16(out, static_cast<uint16_t>(value));
+  PutLe16(out, static_cast<uint16_t>(value >> 16));
+}
+
+void PutLe64(std::vector<uchar>& out, uint64_t value) {
+  PutLe32(out, static_cast<uint32_t>(value));
+  PutLe32(out, static_cast<uint32_t>(value >> 32));
+}
+
+// zero padded octal number filling a tar header field, including its NUL
+void PutOctal(char* field, size_t width, uint64_t value) {
+  std::snprintf(field, width, "%0*llo", static_cast<int>(width - 1),
+                static_cast<unsigned long long>(value));
+}
+
+}  // namespace
+
+ArchiveSink::ArchiveSink(const std::string& archivePath,
+                         const std::string& root)
+    : archivePath_(archivePath),
+      root_(root),
+      format_(FormatFor(archivePath)) {}
+
+ArchiveSink::~ArchiveSink() { Finish(); }
+
+ArchiveFormat ArchiveSink::FormatFor(const std::string& archivePath) {
+  std::string ext = fs::path(archivePath).extension().string();
+  std::transform(ext.begin(), ext.end(), ext.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  return ext == ".zip" ? ArchiveFormat::ZIP : ArchiveFormat::TAR;
+}
+
+bool ArchiveSink::Open() {
+#ifdef _WIN32
+  if (fopen_s(&file_, archivePath_.c_str(), "wb") != 0) {
+    file_ = nullptr;
+  }
+#else
+  file_ = fopen(archivePath_.c_str(), "wb");
+#endif
+  if (file_ == nullptr) {
+    Log(LogLevel::Error) << "Error: cannot create archive " << archivePath_;
+    return false;
+  }
+  setvbuf(file_, nullptr, _IOFBF, kWriteBufferBytes);
+
+  // every entry gets the time the batch started
+  std::time_t now = std::time(nullptr);
+  std::tm local{};
+#ifdef _WIN32
+  localtime_s(&local, &now);
+#else
+  localtime_r(&now, &local);
+#endif
+  dosTime_ = static_cast<uint16_t>((local.tm_hour << 11) |
+                                   (local.tm_min << 5) | (local.tm_sec / 2));
+  dosDate_ = static_cast<uint16_t>(((local.tm_year - 80) << 9) |
+                                   ((local.tm_mon + 1) << 5) | local.tm_mday);
+
+  writer_ = std::thread(&ArchiveSink::WriterLoop, this);
+  return true;
+}
+
+bool ArchiveSink::Write(const std::string& path,
+                        const std::vector<uchar>& data) {
+  Entry entry;
+  entry.path = path;
+  entry.name = fs::path(path).lexically_relative(root_).generic_string();
+  if (entry.name.empty() || entry.name.compare(0, 2, "..") == 0) {
+    entry.name = fs::path(path).filename().generic_string();
+  }
+  // the encode buffer is reused by the calling thread, so the queue keeps
+  // its own copy
+  entry.data = data;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  queueDrained_.wait(lock, [&]() {
+    return queuedBytes_ < kMaxQueuedBytes || closing_;
+  });
+  if (closing_ || file_ == nullptr) {
+    failed_.insert(path);
+    return false;
+  }
+  queuedBytes_ += entry.data.size();
+  queue_.push_back(std::move(entry));
+  queueReady_.notify_one();
+  return true;
+}
+
+bool ArchiveSink::CopyFrom(const std::string& sourcePath,
+                           const std::string& path, bool /*hardLink*/) {
+  std::ifstream file(sourcePath, std::ios::binary | std::ios::ate);
+  std::vector<uchar> data;
+  if (file) {
+    data.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()),
+              static_cast<std::streamsize>(data.size()));
+  }
+  if (!file) {
+    Log(LogLevel::Error) << "Error: cannot read " << sourcePath;
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_.insert(path);
+    return false;
+  }
+  return Write(path, data);
+}
+
+void ArchiveSink::WriterLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queueReady_.wait(lock, [&]() { return !queue_.empty() || closing_; });
+    if (queue_.empty()) break;
+
+    Entry entry = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    bool ok = WriteEntry(entry);
+
+    lock.lock();
+    queuedBytes_ -= entry.data.size();
+    if (ok) {
+      written_.push_back(entry.path);
+    } else {
+      failed_.insert(entry.path);
+    }
+    queueDrained_.notify_all();
+  }
+}
+
+bool ArchiveSink::WriteEntry(const Entry& entry) {
+  if (ioError_) return false;
+  bool ok = format_ == ArchiveFormat::ZIP ? WriteZipEntry(entry)
+                                          : WriteTarEntry(entry);
+  if (!ok && !ioError_) {
+    Log(LogLevel::Error) << "Error: cannot store " << entry.name << " in "
+                         << archivePath_;
+  }
+  return ok;
+}
+
+bool ArchiveSink::Append(const void* data, size_t size) {
+  if (size > 0 && std::fwrite(data, 1, size, file_) != size) {
+    if (!ioError_) {
+      Log(LogLevel::Error) << "Error: failed to write archive " << archivePath_;
+    }
+    ioError_ = true;
+    return false;
+  }
+  offset_ += size;
+  return true;
+}
+
+// ustar header; names longer than 100 bytes are split into prefix and name
+// at a directory separator
+bool ArchiveSink::WriteTarEntry(const Entry& entry) {
+  char header[kTarBlock];
+  std::memset(header, 0, sizeof(header));
+
+  const std::string& name = entry.name;
+  if (name.size() <= 100) {
+    std::memcpy(header, name.data(), name.size());
+  } else {
+    size_t split = name.rfind('/', 155);
+    if (split == std::string::npos || name.size() - split - 1 > 100) {
+      return false;
+    }
+    std::memcpy(header, name.data() + split + 1, name.size() - split - 1);
+    std::memcpy(header + 345, name.data(), split);
+  }
+
+  PutOctal(header + 100, 8, 0644);                // mode
+  PutOctal(header + 108, 8, 0);                   // uid
+  PutOctal(header + 116, 8, 0);                   // gid
+  PutOctal(header + 124, 12, entry.data.size());  // size
+  PutOctal(header + 136, 12, static_cast<uint64_t>(std::time(nullptr)));
+  header[156] = '0';  // regular file
+  std::memcpy(header + 257, "ustar", 6);
+  std::memcpy(header + 263, "00", 2);
+
+  // checksum is computed with its own field set to spaces
+  std::memset(header + 148, ' ', 8);
+  unsigned checksum = 0;
+  for (unsigned char c : header) checksum += c;
+  std::snprintf(header + 148, 8, "%06o", checksum);
+
+  static const char padding[kTarBlock] = {};
+  size_t tail = (kTarBlock - entry.data.size() % kTarBlock) % kTarBlock;
+  return Append(header, sizeof(header)) &&
+         Append(entry.data.data(), entry.data.size()) &&
+         Append(padding, tail);
+}
+
+// stored (uncompressed) zip entry; offsets past 4 GiB are recorded in a
+// zip64 extra field of the central directory
+bool ArchiveSink::WriteZipEntry(const Entry& entry) {
+  if (entry.data.size() >= kZip32Limit || entry.name.size() > kZip16Limit) {
+    return false;
+  }
+
+  ZipRecord record;
+  record.name = entry.name;
+  record.crc = static_cast<uint32_t>(
+      crc32(crc32(0L, Z_NULL, 0), entry.data.data(),
+            static_cast<uInt>(entry.data.size())));
+  record.size = static_cast<uint32_t>(entry.data.size());
+  record.offset = offset_;
+
+  std::vector<uchar> header;
+  PutLe32(header, 0x04034b50);
+  PutLe16(header, record.offset >= kZip32Limit ? 45 : 20);  // version needed
+  PutLe16(header, 0x0800);                                   // utf-8 names
+  PutLe16(header, 0);                                        // stored
+  PutLe16(header, dosTime_);
+  PutLe16(header, dosDate_);
+  PutLe32(header, record.crc);
+  PutLe32(header, record.size);  // compressed size
+  PutLe32(header, record.size);  // uncompressed size
+  PutLe16(header, static_cast<uint16_t>(record.name.size()));
+  PutLe16(header, 0);  // extra field length
+  header.insert(header.end(), record.name.begin(), record.name.end());
+
+  if (!Append(header.data(), header.size()) ||
+      !Append(entry.data.data(), entry.data.size())) {
+    return false;
+  }
+  zipRecords_.push_back(std::move(record));
+  return true;
+}
+
+// two zero blocks for tar; central directory and end records for zip, with
+// zip64 records once the entry count or offsets overflow the classic fields
+bool ArchiveSink::WriteTrailer() {
+  if (format_ == ArchiveFormat::TAR) {
+    static const char zeros[kTarBlock * 2] = {};
+    return Append(zeros, sizeof(zeros));
+  }
+
+  uint64_t directoryOffset = offset_;
+  std::vector<uchar> directory;
+  for (const ZipRecord& record : zipRecords_) {
+    bool zip64 = record.offset >= kZip32Limit;
+    PutLe32(directory, 0x02014b50);
+    PutLe16(directory, zip64 ? 45 : 20);  // version made by
+    PutLe16(directory, zip64 ? 45 : 20);  // version needed
+    PutLe16(directory, 0x0800);
+    PutLe16(directory, 0);
+    PutLe16(directory, dosTime_);
+    PutLe16(directory, dosDate_);
+    PutLe32(directory, record.crc);
+    PutLe32(directory, record.size);
+    PutLe32(directory, record.size);
+    PutLe16(directory, static_cast<uint16_t>(record.name.size()));
+    PutLe16(directory, zip64 ? 12 : 0);  // extra field length
+    PutLe16(directory, 0);               // comment length
+    PutLe16(directory, 0);               // disk number
+    PutLe16(directory, 0);               // internal attributes
+    PutLe32(directory, 0);               // external attributes
+    PutLe32(directory, zip64 ? kZip32Limit
+                             : static_cast<uint32_t>(record.offset));
+    directory.insert(directory.end(), record.name.begin(), record.name.end());
+    if (zip64) {
+      PutLe16(directory, 0x0001);
+      PutLe16(directory, 8);
+      PutLe64(directory, record.offset);
+    }
+  }
+  uint64_t directorySize = directory.size();
+  uint64_t count = zipRecords_.size();
+
+  std::vector<uchar> end;
+  bool zip64 = count >= kZip16Limit || directoryOffset >= kZip32Limit ||
+               directorySize >= kZip32Limit;
+  if (zip64) {
+    uint64_t recordOffset = directoryOffset + directorySize;
+    PutLe32(end, 0x06064b50);
+    PutLe64(end, 44);  // size of the remaining record
+    PutLe16(end, 45);
+    PutLe16(end, 45);
+    PutLe32(end, 0);
+    PutLe32(end, 0);
+    PutLe64(end, count);
+    PutLe64(end, count);
+    PutLe64(end, directorySize);
+    PutLe64(end, directoryOffset);
+
+    PutLe32(end, 0x07064b50);
+    PutLe32(end, 0);
+    PutLe64(end, recordOffset);
+    PutLe32(end, 1);
+  }
+
+  PutLe32(end, 0x06054b50);
+  PutLe16(end, 0);
+  PutLe16(end, 0);
+  uint16_t shortCount = zip64 ? kZip16Limit : static_cast<uint16_t>(count);
+  PutLe16(end, shortCount);
+  PutLe16(end, shortCount);
+  PutLe32(end, zip64 ? kZip32Limit : static_cast<uint32_t>(directorySize));
+  PutLe32(end, zip64 ? kZip32Limit : static_cast<uint32_t>(directoryOffset));
+  PutLe16(end, 0);  // comment length
+
+  return Append(directory.data(), directory.size()) &&
+         Append(end.data(), end.size());
+}
+
+bool ArchiveSink::Finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (finished_) return failed_.empty();
+    finished_ = true;
+    closing_ = true;
+  }
+  queueReady_.notify_all();
+  queueDrained_.notify_all();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  if (file_ == nullptr) return false;
+
+  bool ok = WriteTrailer();
+  ok = std::fclose(file_) == 0 && ok;
+  file_ = nullptr;
+
+  // an archive without its trailer is unusable, so nothing in it counts
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (!ok) {
+    failed_.insert(written_.begin(), written_.end());
+  }
+  return failed_.empty();
+}
+
+std::set<std::string> ArchiveSink::Failed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+
+// entries are written by the writer thread, and the archive is only valid
+// once Finish has written its trailer
+bool ArchiveSink::DefersCommit() const { return true; }
+
+}  // namespace anysticker
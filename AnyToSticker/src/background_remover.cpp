@@ -0,0 +1,143 @@
+#include "../include/background_remover.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <vector>
+
+namespace anysticker {
+
+namespace {
+
+// border pixels that are already transparent above this share mean the
+// image has no background to remove
+constexpr double kTransparentBorderShare = 0.5;
+
+// per-channel median of the opaque border pixels; false when the border is
+// mostly transparent
+bool EstimateBackground(const cv::Mat& image, cv::Vec3b& background) {
+  int histogram[3][256] = {};
+  int opaque = 0, total = 0;
+
+  auto sample = [&](int x, int y) {
+    const cv::Vec4b& p = image.at<cv::Vec4b>(y, x);
+    ++total;
+    if (p[3] == 0) return;
+    ++opaque;
+    for (int c = 0; c < 3; ++c) histogram[c][p[c]]++;
+  };
+  for (int x = 0; x < image.cols; ++x) {
+    sample(x, 0);
+    if (image.rows > 1) sample(x, image.rows - 1);
+  }
+  for (int y = 1; y < image.rows - 1; ++y) {
+    sample(0, y);
+    if (image.cols > 1) sample(image.cols - 1, y);
+  }
+
+  if (opaque == 0 || total - opaque > total * kTransparentBorderShare) {
+    return false;
+  }
+  for (int c = 0; c < 3; ++c) {
+    int seen = 0, value = 0;
+    while (value < 255 && (seen += histogram[c][value]) * 2 < opaque) {
+      ++value;
+    }
+    background[c] = static_cast<uchar>(value);
+  }
+  return true;
+}
+
+// scanline flood fill from every matching border pixel; a pixel belongs to
+// the background when it is transparent or close enough to its color
+cv::Mat FloodBackground(const cv::Mat& image, const cv::Vec3b& background,
+                        int tolerance) {
+  const int width = image.cols, height = image.rows;
+  const int limit = tolerance * tolerance;
+  cv::Mat mask(height, width, CV_8UC1, cv::Scalar(0));
+
+  auto matches = [&](int x, int y) {
+    if (mask.at<uchar>(y, x)) return false;
+    const cv::Vec4b& p = image.at<cv::Vec4b>(y, x);
+    if (p[3] == 0) return true;
+    int distance = 0;
+    for (int c = 0; c < 3; ++c) {
+      int d = p[c] - background[c];
+      distance += d * d;
+    }
+    return distance <= limit;
+  };
+
+  std::vector<cv::Point> seeds;
+  for (int x = 0; x < width; ++x) {
+    seeds.emplace_back(x, 0);
+    seeds.emplace_back(x, height - 1);
+  }
+  for (int y = 0; y < height; ++y) {
+    seeds.emplace_back(0, y);
+    seeds.emplace_back(width - 1, y);
+  }
+
+  while (!seeds.empty()) {
+    cv::Point seed = seeds.back();
+    seeds.pop_back();
+    if (!matches(seed.x, seed.y)) continue;
+
+    // fill the whole run on this row, then queue one seed per matching run
+    // in the rows above and below
+    int left = seed.x, right = seed.x;
+    while (left > 0 && matches(left - 1, seed.y)) --left;
+    while (right < width - 1 && matches(right + 1, seed.y)) ++right;
+    uchar* row = mask.ptr<uchar>(seed.y);
+    for (int x = left; x <= right; ++x) row[x] = 255;
+
+    for (int y : {seed.y - 1, seed.y + 1}) {
+      if (y < 0 || y >= height) continue;
+      bool inRun = false;
+      for (int x = left; x <= right; ++x) {
+        bool match = matches(x, y);
+        if (match && !inRun) seeds.emplace_back(x, y);
+        inRun = match;
+      }
+    }
+  }
+  return mask;
+}
+
+}  // namespace
+
+cv::Mat RemoveBackground(const cv::Mat& bgra,
+                         const BackgroundSettings& settings) {
+  if (bgra.empty() || bgra.type() != CV_8UC4) return bgra;
+
+  cv::Vec3b background;
+  if (!EstimateBackground(bgra, background)) return bgra;
+
+  cv::Mat backgroundMask = FloodBackground(bgra, background,
+                                           settings.tolerance);
+
+  // feather inwards: a blurred foreground mask scales the alpha of edge
+  // pixels, removed pixels stay fully transparent so no halo of the old
+  // background color comes back
+  cv::Mat foreground;
+  cv::bitwise_not(backgroundMask, foreground);
+  cv::Mat soft = foreground;
+  if (settings.featherRadius > 0) {
+    int size = settings.featherRadius * 2 + 1;
+    cv::GaussianBlur(foreground, soft, cv::Size(size, size), 0);
+  }
+
+  cv::Mat output = bgra.clone();
+  for (int y = 0; y < output.rows; ++y) {
+    cv::Vec4b* row = output.ptr<cv::Vec4b>(y);
+    const uchar* removed = backgroundMask.ptr<uchar>(y);
+    const uchar* keep = soft.ptr<uchar>(y);
+    for (int x = 0; x < output.cols; ++x) {
+      row[x][3] = removed[x]
+                      ? 0
+                      : static_cast<uchar>((row[x][3] * keep[x] + 127) / 255);
+    }
+  }
+  return output;
+}
+
+}  // namespace anysticker
@@ -0,0 +1,233 @@
+#include "../include/batch_reader.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+#ifdef ANYSTICKER_WITH_IO_URING
+#include <fcntl.h>
+#include <liburing.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "../include/logger.h"
+#include "../include/profiler.h"
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+// whole file in one read, files over maxBytes are left to the caller
+bool ReadWholeFile(const fs::path& path, size_t maxBytes,
+                   std::vector<uchar>& data) {
+  ScopedStage stage(Stage::READ);
+  std::error_code error;
+  uintmax_t size = fs::file_size(path, error);
+  if (error || size == 0 || size > maxBytes) return false;
+
+  std::ifstream file(path, std::ios::binary);
+  data.resize(static_cast<size_t>(size));
+  return file.read(reinterpret_cast<char*>(data.data()),
+                   static_cast<std::streamsize>(data.size())) &&
+         file.gcount() == static_cast<std::streamsize>(data.size());
+}
+
+BatchReader::BatchReader(const std::vector<fs::path>& files, size_t window,
+                         size_t maxFileBytes)
+    : files_(files),
+      window_(std::max<size_t>(1, window)),
+      maxFileBytes_(maxFileBytes),
+      slots_(files.size()) {}
+
+BatchReader::~BatchReader() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  windowOpen_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+#ifdef ANYSTICKER_WITH_IO_URING
+  if (ring_) {
+    io_uring_queue_exit(static_cast<io_uring*>(ring_));
+    delete static_cast<io_uring*>(ring_);
+  }
+#endif
+}
+
+IoEngine BatchReader::Start(IoEngine engine, int threads) {
+  if (engine == IoEngine::SYNC) return engine;
+
+  if (engine == IoEngine::URING) {
+    if (StartUring()) {
+      threads_.emplace_back(&BatchReader::UringLoop, this);
+      return IoEngine::URING;
+    }
+    Log(LogLevel::Warning)
+        << "Warning: io_uring is not available, reading with threads";
+  }
+
+  // reads block in the kernel, so a few threads are enough to keep the
+  // window full without competing with the decoders for cores
+  int count = std::clamp(threads, 1, static_cast<int>(window_));
+  for (int i = 0; i < count; ++i) {
+    threads_.emplace_back(&BatchReader::PoolLoop, this);
+  }
+  return IoEngine::THREADS;
+}
+
+bool BatchReader::Take(size_t index, std::vector<uchar>& data) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  Slot& slot = slots_[index];
+  ready_.wait(lock, [&]() { return slot.state != SlotState::QUEUED; });
+  bool ok = slot.state == SlotState::READY;
+  if (ok) {
+    data = std::move(slot.data);
+    slot.data = std::vector<uchar>();
+  }
+  ++taken_;
+  lock.unlock();
+  windowOpen_.notify_all();
+  return ok;
+}
+
+bool BatchReader::WaitForWindow(size_t index) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  windowOpen_.wait(lock,
+                   [&]() { return stopping_ || index < taken_ + window_; });
+  return !stopping_;
+}
+
+void BatchReader::Complete(size_t index, bool ok, std::vector<uchar> data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_[index].state = ok ? SlotState::READY : SlotState::SKIPPED;
+    slots_[index].data = std::move(data);
+  }
+  ready_.notify_all();
+}
+
+void BatchReader::PoolLoop() {
+  for (size_t i = next_++; i < files_.size(); i = next_++) {
+    if (!WaitForWindow(i)) return;
+    std::vector<uchar> data;
+    bool ok = ReadWholeFile(files_[i], maxFileBytes_, data);
+    Complete(i, ok, ok ? std::move(data) : std::vector<uchar>());
+  }
+}
+
+#ifdef ANYSTICKER_WITH_IO_URING
+
+namespace {
+
+struct UringRead {
+  size_t index;
+  int fd;
+  size_t done;
+  std::vector<uchar> data;
+};
+
+void QueueRead(io_uring* ring, UringRead* read) {
+  io_uring_sqe* sqe = io_uring_get_sqe(ring);
+  io_uring_prep_read(sqe, read->fd, read->data.data() + read->done,
+                     static_cast<unsigned>(read->data.size() - read->done),
+                     read->done);
+  io_uring_sqe_set_data(sqe, read);
+}
+
+}  // namespace
+
+bool BatchReader::StartUring() {
+  auto ring = std::make_unique<io_uring>();
+  unsigned depth = static_cast<unsigned>(std::min<size_t>(window_, 256));
+  if (io_uring_queue_init(depth, ring.get(), 0) < 0) return false;
+  ring_ = ring.release();
+  return true;
+}
+
+// one thread keeps up to `window` reads queued in the kernel; every read is
+// sized from fstat so a file normally completes with a single request
+void BatchReader::UringLoop() {
+  io_uring* ring = static_cast<io_uring*>(ring_);
+  const size_t depth = ring->sq.ring_entries;
+  size_t submitted = 0;
+  size_t inflight = 0;
+
+  while (true) {
+    size_t queued = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (inflight == 0) {
+        windowOpen_.wait(lock, [&]() {
+          return stopping_ || submitted == files_.size() ||
+                 submitted < taken_ + window_;
+        });
+        if (stopping_ || submitted == files_.size()) return;
+      }
+      while (!stopping_ && inflight + queued < depth &&
+             submitted < files_.size() && submitted < taken_ + window_) {
+        size_t index = submitted++;
+        lock.unlock();
+
+        int fd = open(files_[index].c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0 && info.st_size > 0 &&
+            static_cast<uintmax_t>(info.st_size) <= maxFileBytes_) {
+          auto* read = new UringRead{index, fd, 0, {}};
+          read->data.resize(static_cast<size_t>(info.st_size));
+          QueueRead(ring, read);
+          ++queued;
+        } else {
+          if (fd >= 0) close(fd);
+          Complete(index, false, {});
+        }
+        lock.lock();
+      }
+    }
+    if (queued > 0) {
+      io_uring_submit(ring);
+      inflight += queued;
+    }
+    if (inflight == 0) continue;
+
+    // reap at least one completion, then everything else already finished
+    io_uring_cqe* cqe = nullptr;
+    if (io_uring_wait_cqe(ring, &cqe) < 0) continue;
+    size_t resubmitted = 0;
+    do {
+      auto* read = static_cast<UringRead*>(io_uring_cqe_get_data(cqe));
+      int result = cqe->res;
+      io_uring_cqe_seen(ring, cqe);
+      --inflight;
+
+      if (result > 0) read->done += static_cast<size_t>(result);
+      if (result > 0 && read->done < read->data.size()) {
+        // short read, queue the rest at its offset
+        QueueRead(ring, read);
+        ++resubmitted;
+        continue;
+      }
+      bool ok = result > 0 && read->done == read->data.size();
+      close(read->fd);
+      Complete(read->index, ok, ok ? std::move(read->data)
+                                   : std::vector<uchar>());
+      delete read;
+    } while (io_uring_peek_cqe(ring, &cqe) == 0);
+
+    if (resubmitted > 0) {
+      io_uring_submit(ring);
+      inflight += resubmitted;
+    }
+  }
+}
+
+#else
+
+bool BatchReader::StartUring() { return false; }
+
+void BatchReader::UringLoop() {}
+
+#endif
+
+}  // namespace anysticker
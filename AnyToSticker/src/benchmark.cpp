@@ -0,0 +1,167 @@
+#include "../include/benchmark.h"
+
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <opencv2/opencv.hpp>
+
+#include "../include/logger.h"
+#include "../include/pixel_format.h"
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+namespace {
+
+// every filter is timed for at least this long per image
+constexpr double kMinSecondsPerImage = 0.2;
+
+const ResizeFilter kFilters[] = {
+    ResizeFilter::AREA,     ResizeFilter::BILINEAR, ResizeFilter::BICUBIC,
+    ResizeFilter::LANCZOS3, ResizeFilter::LANCZOS4, ResizeFilter::MITCHELL,
+};
+
+// load an image as 8-bit BGRA, the layout the sticker pipeline resizes
+cv::Mat LoadBgra(const fs::path& path) {
+  cv::Mat image = cv::imread(path.string(), cv::IMREAD_UNCHANGED);
+  cv::Mat bgra;
+  if (image.empty() || !ConvertToBgra(image, bgra)) {
+    return cv::Mat();
+  }
+  return bgra;
+}
+
+}  // namespace
+
+double ComputeSsim(const cv::Mat& a, const cv::Mat& b) {
+  const double c1 = 6.5025, c2 = 58.5225;  // (0.01 * 255)^2, (0.03 * 255)^2
+
+  cv::Mat i1, i2;
+  a.convertTo(i1, CV_32F);
+  b.convertTo(i2, CV_32F);
+
+  cv::Mat mu1, mu2;
+  cv::GaussianBlur(i1, mu1, cv::Size(11, 11), 1.5);
+  cv::GaussianBlur(i2, mu2, cv::Size(11, 11), 1.5);
+
+  cv::Mat mu1Sq = mu1.mul(mu1);
+  cv::Mat mu2Sq = mu2.mul(mu2);
+  cv::Mat mu1Mu2 = mu1.mul(mu2);
+
+  cv::Mat sigma1Sq, sigma2Sq, sigma12;
+  cv::GaussianBlur(i1.mul(i1), sigma1Sq, cv::Size(11, 11), 1.5);
+  sigma1Sq -= mu1Sq;
+  cv::GaussianBlur(i2.mul(i2), sigma2Sq, cv::Size(11, 11), 1.5);
+  sigma2Sq -= mu2Sq;
+  cv::GaussianBlur(i1.mul(i2), sigma12, cv::Size(11, 11), 1.5);
+  sigma12 -= mu1Mu2;
+
+  cv::Mat t1 = 2 * mu1Mu2 + c1;
+  cv::Mat t2 = 2 * sigma12 + c2;
+  cv::Mat numerator = t1.mul(t2);
+  t1 = mu1Sq + mu2Sq + c1;
+  t2 = sigma1Sq + sigma2Sq + c2;
+  cv::Mat denominator = t1.mul(t2);
+
+  cv::Mat ssimMap;
+  cv::divide(numerator, denominator, ssimMap);
+
+  cv::Scalar perChannel = cv::mean(ssimMap);
+  double sum = 0;
+  for (int c = 0; c < a.channels(); ++c) {
+    sum += perChannel[c];
+  }
+  return sum / a.channels();
+}
+
+std::vector<FilterBenchmark> RunResizeBenchmark(
+    const std::string& inputPath, const ProcessingOptions& options) {
+  std::vector<fs::path> files;
+  if (fs::is_directory(inputPath)) {
+    files = ImageProcessor::GetMatchingFiles(inputPath, options.pattern);
+  } else {
+    files.push_back(inputPath);
+  }
+
+  std::vector<FilterBenchmark> results;
+  std::vector<double> seconds;
+  for (ResizeFilter filter : kFilters) {
+    FilterBenchmark result;
+    result.filter = filter;
+    results.push_back(result);
+    seconds.push_back(0);
+  }
+
+  std::vector<double> megapixels(results.size(), 0);
+  int imageCount = 0;
+
+  for (const auto& path : files) {
+    cv::Mat image = LoadBgra(path);
+    if (image.empty()) {
+      Log(LogLevel::Warning) << "Skipping unsupported image: " << path.string();
+      continue;
+    }
+    ++imageCount;
+
+    cv::Size targetSize =
+        ImageProcessor::CalculateTelegramSize(image.cols, image.rows);
+
+    ResampleSettings reference;
+    reference.filter = ResizeFilter::LANCZOS3;
+    reference.linearLight = options.linearLight;
+    reference.antialias = true;
+    cv::Mat expected = Resampler::Resize(image, targetSize, reference);
+
+    double imageMegapixels = image.total() / 1e6;
+    for (size_t i = 0; i < results.size(); ++i) {
+      ResampleSettings settings;
+      settings.filter = results[i].filter;
+      settings.linearLight = options.linearLight;
+
+      cv::Mat output;
+      int runs = 0;
+      auto start = std::chrono::steady_clock::now();
+      double elapsed = 0;
+      do {
+        output = Resampler::Resize(image, targetSize, settings);
+        ++runs;
+        elapsed = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      } while (elapsed < kMinSecondsPerImage);
+
+      seconds[i] += elapsed;
+      megapixels[i] += imageMegapixels * runs;
+      results[i].psnr += cv::PSNR(output, expected);
+      results[i].ssim += ComputeSsim(output, expected);
+    }
+  }
+
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (imageCount == 0) break;
+    results[i].megapixelsPerSecond = megapixels[i] / seconds[i];
+    results[i].psnr /= imageCount;
+    results[i].ssim /= imageCount;
+  }
+
+  Log(LogLevel::Info) << "Benchmarked " << imageCount << " images with "
+                      << cv::getNumThreads() << " threads";
+  return results;
+}
+
+void PrintBenchmark(const std::vector<FilterBenchmark>& results) {
+  std::cout << std::left << std::setw(12) << "filter" << std::right
+            << std::setw(12) << "MP/s" << std::setw(12) << "PSNR(dB)"
+            << std::setw(10) << "SSIM" << "\n";
+  for (const auto& result : results) {
+    std::cout << std::left << std::setw(12) << ResizeFilterName(result.filter)
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << result.megapixelsPerSecond
+              << std::setprecision(2) << std::setw(12) << result.psnr
+              << std::setprecision(4) << std::setw(10) << result.ssim << "\n";
+  }
+  std::cout << std::flush;
+}
+
+}  // namespace anysticker
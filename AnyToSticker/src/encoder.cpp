@@ -0,0 +1,187 @@
+#include "../include/encoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <opencv2/imgcodecs.hpp>
+
+#include "../include/png_writer.h"
+#include "../include/quantizer.h"
+#include "../include/webp_encoder.h"
+
+namespace anysticker {
+
+namespace {
+
+// keep predicted sizes this far below the budget, so the second pass lands
+// under the limit even when the prediction is slightly optimistic
+constexpr double kBudgetMargin = 0.95;
+
+// give up refining after this many encoder runs
+constexpr int kMaxPasses = 5;
+
+constexpr int kPngCompressionLevel = 9;
+
+// palette sizes tried when a png does not fit, halved after every pass
+constexpr int kPaletteColors = 256;
+constexpr int kMinPaletteColors = 32;
+
+// first lossy quality tried when a lossless encode does not fit
+constexpr int kLossyFallbackQuality = 90;
+
+// relative libwebp lossy output size at quality 0, 10, ..., 100 for typical
+// sticker artwork; only the ratios matter, they turn one measured size into
+// a size estimate for every other quality
+constexpr double kWebpSizeCurve[] = {0.25, 0.33, 0.40, 0.46, 0.52, 0.58,
+                                     0.65, 0.76, 0.95, 1.45, 2.90};
+
+double WebpSizeFactor(int quality) {
+  double position = std::clamp(quality, 0, 100) / 10.0;
+  int lower = std::min(static_cast<int>(position), 9);
+  double t = position - lower;
+  // interpolate in log space, the curve is close to exponential
+  return std::exp(std::log(kWebpSizeCurve[lower]) * (1 - t) +
+                  std::log(kWebpSizeCurve[lower + 1]) * t);
+}
+
+// highest quality below `measuredQuality` whose predicted size fits `target`
+int PredictQuality(size_t measuredBytes, int measuredQuality, double target) {
+  double base = measuredBytes / WebpSizeFactor(measuredQuality);
+  for (int q = measuredQuality - 1; q > 1; --q) {
+    if (base * WebpSizeFactor(q) <= target) return q;
+  }
+  return 1;
+}
+
+bool CanQuantize(const cv::Mat& image) {
+  return image.depth() == CV_8U &&
+         (image.channels() == 3 || image.channels() == 4);
+}
+
+bool EncodeQuantizedPng(const cv::Mat& image, const ProcessingOptions& options,
+                        int colors, std::vector<uchar>& buffer) {
+  PaletteImage quantized;
+  if (!QuantizeImage(image, colors, options.dither, quantized)) {
+    return false;
+  }
+  return EncodeIndexedPng(quantized.indices, quantized.palette,
+                          kPngCompressionLevel,
+                          ImageProcessor::ThreadsPerFile(options), buffer);
+}
+
+bool EncodeOnce(const cv::Mat& image, const ProcessingOptions& options,
+                int quality, bool lossless, std::vector<uchar>& buffer) {
+  if (options.format == OutputFormat::WEBP) {
+    return EncodeWebp(image, options.webp, quality, lossless, buffer);
+  }
+  if (options.quantize && CanQuantize(image)) {
+    return EncodeQuantizedPng(image, options, kPaletteColors, buffer);
+  }
+  if (image.depth() == CV_8U) {
+    return EncodePng(image, kPngCompressionLevel,
+                     ImageProcessor::ThreadsPerFile(options), buffer);
+  }
+  return cv::imencode(".png", image, buffer,
+                      {cv::IMWRITE_PNG_COMPRESSION, kPngCompressionLevel});
+}
+
+// png can only shrink by dropping colors: retry as an indexed png with an
+// ever smaller palette until the output fits
+void FitPngBudget(const cv::Mat& image, const ProcessingOptions& options,
+                  std::vector<uchar>& buffer, EncodeStats& stats) {
+  size_t budget = options.sizeBudget;
+  int colors = options.quantize ? kPaletteColors / 2 : kPaletteColors;
+  std::vector<uchar> candidate;
+  while (CanQuantize(image) && stats.passes < kMaxPasses &&
+         colors >= kMinPaletteColors) {
+    if (!EncodeQuantizedPng(image, options, colors, candidate)) break;
+    stats.passes++;
+    if (candidate.size() < buffer.size()) {
+      buffer.swap(candidate);
+      stats.bytes = buffer.size();
+      stats.colors = colors;
+    }
+    if (buffer.size() <= budget) break;
+    colors /= 2;
+  }
+  stats.withinBudget = buffer.size() <= budget;
+}
+
+}  // namespace
+
+bool EncodeImage(const cv::Mat& image, const ProcessingOptions& options,
+                 std::vector<uchar>& buffer, EncodeStats& stats) {
+  stats = EncodeStats();
+  stats.quality = options.quality;
+  stats.lossless =
+      options.format == OutputFormat::WEBP && options.webp.lossless;
+
+  if (!EncodeOnce(image, options, options.quality, stats.lossless, buffer)) {
+    return false;
+  }
+  stats.passes = 1;
+  stats.bytes = buffer.size();
+  if (options.format == OutputFormat::PNG && options.quantize &&
+      CanQuantize(image)) {
+    stats.colors = kPaletteColors;
+  }
+
+  size_t budget = options.sizeBudget;
+  if (budget == 0 || buffer.size() <= budget) {
+    return true;
+  }
+
+  if (options.format != OutputFormat::WEBP) {
+    FitPngBudget(image, options, buffer, stats);
+    return true;
+  }
+
+  if (options.quality <= 1 && !options.webp.lossless) {
+    stats.withinBudget = false;
+    return true;
+  }
+
+  double target = budget * kBudgetMargin;
+
+  // each measurement is (quality, log size); the first lossy one is predicted
+  // from the size curve, later ones from the secant of the last two samples
+  int lastQuality = options.quality;
+  double lastLogSize = std::log(static_cast<double>(buffer.size()));
+  int quality;
+  if (options.webp.lossless) {
+    quality = kLossyFallbackQuality;
+    lastQuality = 0;
+  } else {
+    quality = PredictQuality(buffer.size(), options.quality, target);
+  }
+
+  while (stats.passes < kMaxPasses) {
+    if (!EncodeOnce(image, options, quality, false, buffer)) {
+      return false;
+    }
+    stats.passes++;
+    stats.quality = quality;
+    stats.lossless = false;
+    stats.bytes = buffer.size();
+
+    if (buffer.size() <= budget || quality <= 1) break;
+
+    double logSize = std::log(static_cast<double>(buffer.size()));
+    int next;
+    if (lastQuality > quality && lastLogSize > logSize) {
+      double slope = (lastLogSize - logSize) / (lastQuality - quality);
+      next = static_cast<int>(
+          std::floor(quality - (logSize - std::log(target)) / slope));
+    } else {
+      next = PredictQuality(buffer.size(), quality, target);
+    }
+
+    lastQuality = quality;
+    lastLogSize = logSize;
+    quality = std::clamp(next, 1, quality - 1);
+  }
+
+  stats.withinBudget = buffer.size() <= budget;
+  return true;
+}
+
+}  // namespace anysticker
@@ -0,0 +1,320 @@
+#include "../include/file_sink.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <share.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef ANYSTICKER_WITH_IO_URING
+#include <liburing.h>
+#endif
+
+#include "../include/logger.h"
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+namespace {
+
+std::atomic<unsigned> tempCounter{0};
+
+int OpenForWrite(const std::string& path) {
+#ifdef _WIN32
+  int fd = -1;
+  _sopen_s(&fd, path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+           _SH_DENYWR, _S_IREAD | _S_IWRITE);
+  return fd;
+#else
+  return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+}
+
+// one write call in the common case, the loop only covers short writes
+bool WriteAll(int fd, const uchar* data, size_t size) {
+  while (size > 0) {
+#ifdef _WIN32
+    unsigned chunk = static_cast<unsigned>(std::min<size_t>(size, 1u << 30));
+    int written = _write(fd, data, chunk);
+#else
+    ssize_t written = write(fd, data, size);
+#endif
+    if (written <= 0) return false;
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+  return true;
+}
+
+int OpenForRead(const std::string& path) {
+#ifdef _WIN32
+  int fd = -1;
+  _sopen_s(&fd, path.c_str(), _O_RDONLY | _O_BINARY, _SH_DENYNO, 0);
+  return fd;
+#else
+  return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#endif
+}
+
+// copy the rest of `source` into `target`: a reflink shares the extents
+// without copying, copy_file_range keeps the copy inside the kernel, and a
+// plain read/write loop covers everything else
+bool CopyContents(int source, int target) {
+#ifdef __linux__
+  if (ioctl(target, FICLONE, source) == 0) return true;
+  while (true) {
+    ssize_t copied = copy_file_range(source, nullptr, target, nullptr,
+                                     1 << 30, 0);
+    if (copied == 0) return true;
+    if (copied < 0) break;  // not supported here, finish with read/write
+  }
+#endif
+  std::vector<uchar> buffer(1024 * 1024);
+  while (true) {
+#ifdef _WIN32
+    int count = _read(source, buffer.data(),
+                      static_cast<unsigned>(buffer.size()));
+#else
+    ssize_t count = read(source, buffer.data(), buffer.size());
+#endif
+    if (count == 0) return true;
+    if (count < 0 ||
+        !WriteAll(target, buffer.data(), static_cast<size_t>(count))) {
+      return false;
+    }
+  }
+}
+
+bool SyncFile(int fd) {
+#ifdef _WIN32
+  return _commit(fd) == 0;
+#else
+  return fsync(fd) == 0;
+#endif
+}
+
+// sync a whole group of files. with io_uring every fsync is queued at once,
+// so the device sees the full queue depth instead of one flush at a time
+std::vector<bool> SyncFiles(const std::vector<int>& fds) {
+  std::vector<bool> ok(fds.size(), false);
+#ifdef ANYSTICKER_WITH_IO_URING
+  io_uring ring;
+  unsigned depth = static_cast<unsigned>(std::min<size_t>(fds.size(), 256));
+  if (depth > 0 && io_uring_queue_init(depth, &ring, 0) == 0) {
+    size_t next = 0, done = 0;
+    while (done < fds.size()) {
+      for (; next < fds.size(); ++next) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) break;
+        io_uring_prep_fsync(sqe, fds[next], 0);
+        io_uring_sqe_set_data64(sqe, next);
+      }
+      io_uring_cqe* cqe = nullptr;
+      if (io_uring_submit_and_wait(&ring, 1) < 0 ||
+          io_uring_wait_cqe(&ring, &cqe) < 0) {
+        break;
+      }
+      do {
+        ok[io_uring_cqe_get_data64(cqe)] = cqe->res == 0;
+        io_uring_cqe_seen(&ring, cqe);
+        ++done;
+      } while (io_uring_peek_cqe(&ring, &cqe) == 0);
+    }
+    io_uring_queue_exit(&ring);
+    if (done == fds.size()) return ok;
+    // the ring broke down midway, fsync is idempotent so redo them all
+  }
+#endif
+  for (size_t i = 0; i < fds.size(); ++i) {
+    ok[i] = SyncFile(fds[i]);
+  }
+  return ok;
+}
+
+void CloseFile(int fd) {
+#ifdef _WIN32
+  _close(fd);
+#else
+  close(fd);
+#endif
+}
+
+// make the renames themselves durable; windows has no directory handles
+// that can be flushed this way
+void SyncDirectory(const fs::path& directory) {
+#ifndef _WIN32
+  int fd = open(directory.empty() ? "." : directory.c_str(),
+                O_RDONLY | O_CLOEXEC);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#else
+  (void)directory;
+#endif
+}
+
+// hidden name next to the target, so the rename never crosses file systems
+// and directory listings of finished output skip it
+std::string TempPathFor(const std::string& path) {
+#ifdef _WIN32
+  int pid = _getpid();
+#else
+  int pid = static_cast<int>(getpid());
+#endif
+  fs::path target(path);
+  std::string name = "." + target.filename().string() + "." +
+                     std::to_string(pid) + "." +
+                     std::to_string(tempCounter++) + ".tmp";
+  return (target.parent_path() / name).string();
+}
+
+}  // namespace
+
+FileSink::FileSink(bool durable, size_t syncBatch)
+    : durable_(durable), syncBatch_(durable ? std::max<size_t>(1, syncBatch)
+                                            : 1) {}
+
+FileSink::~FileSink() { Finish(); }
+
+bool FileSink::Write(const std::string& path, const std::vector<uchar>& data) {
+  Pending entry{TempPathFor(path), path, -1};
+  entry.fd = OpenForWrite(entry.tempPath);
+  if (entry.fd < 0) {
+    Log(LogLevel::Error) << "Error: cannot create " << entry.tempPath;
+    return false;
+  }
+
+  if (!WriteAll(entry.fd, data.data(), data.size())) {
+    Log(LogLevel::Error) << "Error: failed to write " << path;
+    CloseFile(entry.fd);
+    std::error_code ignored;
+    fs::remove(entry.tempPath, ignored);
+    return false;
+  }
+
+  return Enqueue(std::move(entry));
+}
+
+bool FileSink::CopyFrom(const std::string& sourcePath, const std::string& path,
+                        bool hardLink) {
+  Pending entry{TempPathFor(path), path, -1};
+
+  // a hard link writes no data, so there is nothing to sync either
+  std::error_code error;
+  if (hardLink) {
+    fs::create_hard_link(sourcePath, entry.tempPath, error);
+    if (!error) return Enqueue(std::move(entry));
+  }
+
+  int source = OpenForRead(sourcePath);
+  if (source < 0) {
+    Log(LogLevel::Error) << "Error: cannot read " << sourcePath;
+    return false;
+  }
+  entry.fd = OpenForWrite(entry.tempPath);
+  bool ok = entry.fd >= 0 && CopyContents(source, entry.fd);
+  CloseFile(source);
+  if (!ok) {
+    Log(LogLevel::Error) << "Error: failed to copy " << sourcePath << " to "
+                         << path;
+    if (entry.fd >= 0) CloseFile(entry.fd);
+    fs::remove(entry.tempPath, error);
+    return false;
+  }
+  return Enqueue(std::move(entry));
+}
+
+bool FileSink::Enqueue(Pending entry) {
+  // the file stays open until its group is synced, which saves reopening it
+  std::vector<Pending> group;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(std::move(entry));
+    if (pending_.size() >= syncBatch_) {
+      group.swap(pending_);
+    }
+  }
+  return group.empty() || Commit(group);
+}
+
+// when durable, every file is synced before its rename and the directories
+// touched by the group are synced once at the end. otherwise the rename
+// alone keeps readers from seeing partial files
+bool FileSink::Commit(std::vector<Pending>& group) {
+  if (group.empty()) return true;
+
+  std::vector<int> fds;
+  for (const Pending& entry : group) {
+    if (entry.fd >= 0) fds.push_back(entry.fd);
+  }
+  std::vector<bool> synced =
+      durable_ ? SyncFiles(fds) : std::vector<bool>(fds.size(), true);
+
+  bool allOk = true;
+  size_t syncIndex = 0;
+  std::set<fs::path> directories;
+  for (Pending& entry : group) {
+    bool ok = true;
+    if (entry.fd >= 0) {
+      ok = synced[syncIndex++];
+      CloseFile(entry.fd);
+    }
+
+    std::error_code error;
+    if (ok) {
+      fs::rename(entry.tempPath, entry.path, error);
+      ok = !error;
+    }
+    if (ok) {
+      directories.insert(fs::path(entry.path).parent_path());
+      continue;
+    }
+
+    Log(LogLevel::Error) << "Error: failed to commit " << entry.path;
+    fs::remove(entry.tempPath, error);
+    allOk = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    failed_.insert(entry.path);
+  }
+
+  if (durable_) {
+    for (const fs::path& directory : directories) {
+      SyncDirectory(directory);
+    }
+  }
+  group.clear();
+  return allOk;
+}
+
+bool FileSink::Finish() {
+  std::vector<Pending> group;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    group.swap(pending_);
+  }
+  return Commit(group);
+}
+
+std::set<std::string> FileSink::Failed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+
+bool FileSink::DefersCommit() const { return syncBatch_ > 1; }
+
+}  // namespace anysticker
@@ -0,0 +1,153 @@
+#include "../include/image_format.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace anysticker {
+
+namespace {
+
+uint32_t ReadBe32(const uchar* p) {
+  return (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) |
+         p[3];
+}
+
+bool HasBytes(const uchar* data, size_t size, size_t offset,
+              const char* magic, size_t length) {
+  return size >= offset + length && memcmp(data + offset, magic, length) == 0;
+}
+
+bool IsPng(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "\x89PNG\r\n\x1a\n", 8);
+}
+
+bool IsJpeg(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "\xFF\xD8\xFF", 3);
+}
+
+bool IsGif(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "GIF87a", 6) ||
+         HasBytes(data, size, 0, "GIF89a", 6);
+}
+
+bool IsWebp(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "RIFF", 4) &&
+         HasBytes(data, size, 8, "WEBP", 4);
+}
+
+bool IsBmp(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "BM", 2) && size >= 26;
+}
+
+bool IsTiff(const uchar* data, size_t size) {
+  return HasBytes(data, size, 0, "II*\0", 4) ||
+         HasBytes(data, size, 0, "MM\0*", 4);
+}
+
+bool AlwaysAnimated(const uchar*, size_t) { return true; }
+
+bool NeverAnimated(const uchar*, size_t) { return false; }
+
+// an apng announces itself with acTL somewhere before the first IDAT. the
+// walk covers every chunk up to IDAT, however large the chunks before it
+bool IsAnimatedPng(const uchar* data, size_t size) {
+  size_t pos = 8;
+  while (pos + 8 <= size) {
+    if (memcmp(data + pos + 4, "acTL", 4) == 0) return true;
+    if (memcmp(data + pos + 4, "IDAT", 4) == 0) return false;
+    uint64_t length = ReadBe32(data + pos);
+    if (length + 12 > size - pos) return false;
+    pos += static_cast<size_t>(length) + 12;
+  }
+  return false;
+}
+
+// the same walk over a file that is not in memory, reading only the chunk
+// headers
+bool IsAnimatedPngFile(FILE* f) {
+  uchar chunk[8];
+  if (fseek(f, 8, SEEK_SET) != 0) return false;
+  while (fread(chunk, 1, sizeof(chunk), f) == sizeof(chunk)) {
+    if (memcmp(chunk + 4, "acTL", 4) == 0) return true;
+    if (memcmp(chunk + 4, "IDAT", 4) == 0) return false;
+    // the chunk data (at most 2^31 - 1 bytes, which fits a long), then
+    // its crc
+    if (fseek(f, static_cast<long>(ReadBe32(chunk) & 0x7FFFFFFF), SEEK_CUR) !=
+            0 ||
+        fseek(f, 4, SEEK_CUR) != 0) {
+      return false;
+    }
+  }
+  return false;
+}
+
+// the VP8X header carries the animation flag of an extended webp
+bool IsAnimatedWebp(const uchar* data, size_t size) {
+  return HasBytes(data, size, 12, "VP8X", 4) && size > 20 &&
+         (data[20] & 0x02) != 0;
+}
+
+struct FormatEntry {
+  ImageFormat format;
+  const char* name;
+  bool (*matches)(const uchar* data, size_t size);
+  bool (*animated)(const uchar* data, size_t size);
+};
+
+// every supported input, probed in order. gifs always take the giflib path,
+// which handles them better than the generic decoder
+const FormatEntry kFormats[] = {
+    {ImageFormat::PNG, "png", IsPng, IsAnimatedPng},
+    {ImageFormat::JPEG, "jpeg", IsJpeg, NeverAnimated},
+    {ImageFormat::GIF, "gif", IsGif, AlwaysAnimated},
+    {ImageFormat::WEBP, "webp", IsWebp, IsAnimatedWebp},
+    {ImageFormat::BMP, "bmp", IsBmp, NeverAnimated},
+    {ImageFormat::TIFF, "tiff", IsTiff, NeverAnimated},
+};
+
+}  // namespace
+
+InputFormat SniffFormat(const uchar* data, size_t size) {
+  InputFormat result;
+  for (const FormatEntry& entry : kFormats) {
+    if (entry.matches(data, size)) {
+      result.format = entry.format;
+      result.animated = entry.animated(data, size);
+      break;
+    }
+  }
+  return result;
+}
+
+InputFormat SniffFile(const std::string& path) {
+  FILE* f = nullptr;
+#ifdef _WIN32
+  if (fopen_s(&f, path.c_str(), "rb") != 0 || f == nullptr) {
+    return InputFormat();
+  }
+#else
+  f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return InputFormat();
+  }
+#endif
+
+  uchar header[kSniffBytes];
+  size_t read = fread(header, 1, sizeof(header), f);
+  InputFormat format = SniffFormat(header, read);
+  // acTL may sit behind large iCCP or text chunks, outside the first bytes
+  if (format.format == ImageFormat::PNG && !format.animated) {
+    format.animated = IsAnimatedPngFile(f);
+  }
+  fclose(f);
+  return format;
+}
+
+const char* FormatName(ImageFormat format) {
+  for (const FormatEntry& entry : kFormats) {
+    if (entry.format == format) return entry.name;
+  }
+  return "unknown";
+}
+
+}  // namespace anysticker
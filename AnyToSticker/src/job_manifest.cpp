@@ -0,0 +1,303 @@
+#include "../include/job_manifest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+namespace anysticker {
+
+namespace {
+
+struct JsonValue {
+  enum class Type { STRING, NUMBER, BOOL, NUL } type = Type::NUL;
+  std::string text;
+  double number = 0;
+  bool boolean = false;
+};
+
+using JsonObject = std::vector<std::pair<std::string, JsonValue>>;
+
+// just enough JSON for one flat object per line: string, number, boolean and
+// null values. nested objects and arrays are rejected
+class LineParser {
+ public:
+  explicit LineParser(const std::string& text) : text_(text) {}
+
+  bool ParseObject(JsonObject& object, std::string& error) {
+    SkipSpace();
+    if (!Consume('{')) return Fail("expected '{'", error);
+    SkipSpace();
+    if (Consume('}')) return AtEnd(error);
+    while (true) {
+      std::string key;
+      JsonValue value;
+      SkipSpace();
+      if (!ParseString(key)) return Fail("expected a key", error);
+      SkipSpace();
+      if (!Consume(':')) return Fail("expected ':'", error);
+      SkipSpace();
+      if (!ParseValue(value)) return Fail("bad value for " + key, error);
+      object.emplace_back(std::move(key), std::move(value));
+      SkipSpace();
+      if (Consume('}')) return AtEnd(error);
+      if (!Consume(',')) return Fail("expected ',' or '}'", error);
+    }
+  }
+
+ private:
+  bool ParseValue(JsonValue& value) {
+    if (Peek() == '"') {
+      value.type = JsonValue::Type::STRING;
+      return ParseString(value.text);
+    }
+    if (Literal("true")) {
+      value.type = JsonValue::Type::BOOL;
+      value.boolean = true;
+      return true;
+    }
+    if (Literal("false")) {
+      value.type = JsonValue::Type::BOOL;
+      value.boolean = false;
+      return true;
+    }
+    if (Literal("null")) {
+      value.type = JsonValue::Type::NUL;
+      return true;
+    }
+    const char* begin = text_.c_str() + pos_;
+    char* end = nullptr;
+    value.number = std::strtod(begin, &end);
+    if (end == begin || !std::isfinite(value.number)) return false;
+    value.type = JsonValue::Type::NUMBER;
+    pos_ += static_cast<size_t>(end - begin);
+    return true;
+  }
+
+  bool ParseString(std::string& out) {
+    if (!Consume('"')) return false;
+    while (pos_ < text_.size()) {
+      char c = text_[pos_++];
+      if (c == '"') return true;
+      if (c != '\\') {
+        out += c;
+        continue;
+      }
+      if (pos_ >= text_.size()) return false;
+      switch (text_[pos_++]) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u':
+          if (!ParseEscapedCodePoint(out)) return false;
+          break;
+        default:
+          return false;
+      }
+    }
+    return false;
+  }
+
+  // \uXXXX, with surrogate pairs, appended as UTF-8
+  bool ParseEscapedCodePoint(std::string& out) {
+    uint32_t code = 0;
+    if (!ParseHex4(code)) return false;
+    if (code >= 0xD800 && code < 0xDC00) {
+      uint32_t low = 0;
+      if (!Literal("\\u") || !ParseHex4(low) || low < 0xDC00 ||
+          low >= 0xE000) {
+        return false;
+      }
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+    }
+    if (code < 0x80) {
+      out += static_cast<char>(code);
+    } else if (code < 0x800) {
+      out += static_cast<char>(0xC0 | (code >> 6));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else if (code < 0x10000) {
+      out += static_cast<char>(0xE0 | (code >> 12));
+      out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    } else {
+      out += static_cast<char>(0xF0 | (code >> 18));
+      out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+      out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+      out += static_cast<char>(0x80 | (code & 0x3F));
+    }
+    return true;
+  }
+
+  bool ParseHex4(uint32_t& value) {
+    if (pos_ + 4 > text_.size()) return false;
+    for (int i = 0; i < 4; ++i) {
+      char c = text_[pos_++];
+      int digit = c >= '0' && c <= '9'   ? c - '0'
+                  : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                  : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                         : -1;
+      if (digit < 0) return false;
+      value = value * 16 + static_cast<uint32_t>(digit);
+    }
+    return true;
+  }
+
+  bool Literal(const char* word) {
+    size_t length = std::char_traits<char>::length(word);
+    if (text_.compare(pos_, length, word) != 0) return false;
+    pos_ += length;
+    return true;
+  }
+
+  bool AtEnd(std::string& error) {
+    SkipSpace();
+    return pos_ == text_.size() || Fail("trailing characters", error);
+  }
+
+  bool Fail(const std::string& message, std::string& error) {
+    error = message + " at column " + std::to_string(pos_ + 1);
+    return false;
+  }
+
+  void SkipSpace() {
+    while (pos_ < text_.size() &&
+           (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\r')) {
+      ++pos_;
+    }
+  }
+
+  char Peek() const { return pos_ < text_.size() ? text_[pos_] : '\0'; }
+
+  bool Consume(char c) {
+    if (Peek() != c) return false;
+    ++pos_;
+    return true;
+  }
+
+  const std::string& text_;
+  size_t pos_ = 0;
+};
+
+// apply one "key": value pair of a job line on top of the defaults
+bool ApplyField(const std::string& key, const JsonValue& value, Job& job,
+                std::string& error) {
+  using Type = JsonValue::Type;
+  ProcessingOptions& options = job.options;
+  auto expect = [&](Type type, const char* name) {
+    if (value.type == type) return true;
+    error = key + " must be " + name;
+    return false;
+  };
+  auto integer = [&]() { return static_cast<int>(std::lround(value.number)); };
+
+  if (key == "input") {
+    if (!expect(Type::STRING, "a string")) return false;
+    job.inputPath = value.text;
+  } else if (key == "output") {
+    if (!expect(Type::STRING, "a string")) return false;
+    job.outputPath = value.text;
+  } else if (key == "format") {
+    if (!expect(Type::STRING, "a string")) return false;
+    if (value.text != "png" && value.text != "webp") {
+      error = "unknown format " + value.text;
+      return false;
+    }
+    options.format =
+        value.text == "webp" ? OutputFormat::WEBP : OutputFormat::PNG;
+    // the job's format replaces --formats, the --sizes stay
+    std::vector<OutputSpec> outputs;
+    for (const OutputSpec& spec : options.outputs) {
+      bool seen = std::any_of(
+          outputs.begin(), outputs.end(),
+          [&](const OutputSpec& other) { return other.size == spec.size; });
+      if (!seen) outputs.push_back({options.format, spec.size});
+    }
+    options.outputs = outputs;
+  } else if (key == "quality") {
+    if (!expect(Type::NUMBER, "a number")) return false;
+    options.quality = std::clamp(integer(), 1, 100);
+  } else if (key == "budget") {
+    if (!expect(Type::NUMBER, "a number")) return false;
+    options.sizeBudget = static_cast<size_t>(std::max(0, integer())) * 1024;
+  } else if (key == "bg_tolerance") {
+    if (!expect(Type::NUMBER, "a number")) return false;
+    options.background.tolerance = std::clamp(integer(), 0, 442);
+  } else if (key == "bg_feather") {
+    if (!expect(Type::NUMBER, "a number")) return false;
+    options.background.featherRadius = std::clamp(integer(), 0, 16);
+  } else if (key == "filter") {
+    if (!expect(Type::STRING, "a string")) return false;
+    if (!ParseResizeFilter(value.text, options.filter)) {
+      error = "unknown filter " + value.text;
+      return false;
+    }
+  } else {
+    static const std::pair<const char*, bool ProcessingOptions::*> kFlags[] = {
+        {"quantize", &ProcessingOptions::quantize},
+        {"dither", &ProcessingOptions::dither},
+        {"trim", &ProcessingOptions::trim},
+        {"remove_bg", &ProcessingOptions::removeBackground},
+        {"linear", &ProcessingOptions::linearLight},
+        {"passthrough", &ProcessingOptions::passthrough},
+        {"animated", &ProcessingOptions::animated},
+    };
+    for (const auto& flag : kFlags) {
+      if (key == flag.first) {
+        if (!expect(Type::BOOL, "true or false")) return false;
+        options.*flag.second = value.boolean;
+        return true;
+      }
+    }
+    error = "unknown field " + key;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+JobManifest::JobManifest(const std::string& path,
+                         const ProcessingOptions& defaults)
+    : path_(path), defaults_(defaults) {}
+
+bool JobManifest::Open() {
+  file_.open(path_, std::ios::binary);
+  return file_.is_open();
+}
+
+bool JobManifest::Next(Job& job) {
+  std::string text;
+  {
+    // only the line read is serialized, parsing runs on the calling worker
+    std::lock_guard<std::mutex> lock(mutex_);
+    do {
+      if (!std::getline(file_, text)) return false;
+      ++line_;
+    } while (text.find_first_not_of(" \t\r") == std::string::npos);
+    job.line = line_;
+  }
+
+  job.inputPath.clear();
+  job.outputPath.clear();
+  job.options = defaults_;
+  job.error.clear();
+
+  JsonObject object;
+  LineParser parser(text);
+  if (!parser.ParseObject(object, job.error)) return true;
+  for (const auto& field : object) {
+    if (!ApplyField(field.first, field.second, job, job.error)) return true;
+  }
+  if (job.inputPath.empty()) {
+    job.error = "missing input";
+  }
+  return true;
+}
+
+}  // namespace anysticker
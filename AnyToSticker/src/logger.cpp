@@ -0,0 +1,228 @@
+#include "../include/logger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace anysticker {
+
+namespace {
+
+// a thread's buffer goes to the writer once it holds this much, even in the
+// middle of a file
+constexpr size_t kThreadBufferBytes = 64 * 1024;
+
+std::atomic<int> maxLevel{static_cast<int>(LogLevel::Info)};
+
+// consecutive lines for the same stream
+struct Record {
+  bool error = false;
+  std::string text;
+};
+
+// the only place that writes to the terminal. streams are flushed once per
+// batch of records instead of once per line
+class Writer {
+ public:
+  Writer() : thread_([this] { Run(); }) {}
+
+  ~Writer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    wake_.notify_all();
+    thread_.join();
+  }
+
+  void Push(std::vector<Record>&& records) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(std::move(records));
+    }
+    wake_.notify_one();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && !busy_; });
+  }
+
+ private:
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) return;
+
+      std::deque<std::vector<Record>> batch;
+      batch.swap(queue_);
+      busy_ = true;
+      lock.unlock();
+
+      for (const std::vector<Record>& records : batch) {
+        for (const Record& record : records) {
+          std::ostream& stream = record.error ? std::cerr : std::cout;
+          stream.write(record.text.data(),
+                       static_cast<std::streamsize>(record.text.size()));
+        }
+      }
+      std::cout.flush();
+      std::cerr.flush();
+
+      lock.lock();
+      busy_ = false;
+      idle_.notify_all();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::deque<std::vector<Record>> queue_;
+  bool busy_ = false;
+  bool stopping_ = false;
+  std::thread thread_;
+};
+
+Writer& GetWriter() {
+  static Writer writer;
+  return writer;
+}
+
+// stream buffer that appends to the end of a string, so a line is formatted
+// straight into the record it belongs to
+class AppendBuffer : public std::streambuf {
+ public:
+  void SetTarget(std::string* target) { target_ = target; }
+
+ protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      target_->push_back(traits_type::to_char_type(c));
+    }
+    return traits_type::not_eof(c);
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize count) override {
+    target_->append(s, static_cast<size_t>(count));
+    return count;
+  }
+
+ private:
+  std::string* target_ = nullptr;
+};
+
+// lines of the current thread not yet handed to the writer, handed over when
+// the thread exits at the latest
+struct ThreadBuffer {
+  std::vector<Record> records;
+  size_t bytes = 0;
+
+  // the line being formatted, if any
+  AppendBuffer lineBuffer;
+  std::ostream line{&lineBuffer};
+  bool lineOpen = false;
+  size_t lineStart = 0;
+  std::vector<Record> deferred;  // nested lines, appended after it
+
+  ~ThreadBuffer() { Submit(); }
+
+  std::ostream& BeginLine(bool error) {
+    if (records.empty() || records.back().error != error) {
+      records.push_back(Record{error, std::string()});
+    }
+    std::string& text = records.back().text;
+    lineStart = text.size();
+    lineBuffer.SetTarget(&text);
+    // manipulators used on the previous line do not carry over
+    line.clear();
+    line.flags(std::ios_base::dec | std::ios_base::skipws);
+    line.precision(6);
+    line.width(0);
+    line.fill(' ');
+    lineOpen = true;
+    return line;
+  }
+
+  void EndLine() {
+    std::string& text = records.back().text;
+    text += '\n';
+    bytes += text.size() - lineStart;
+    lineOpen = false;
+    std::vector<Record> nested;
+    nested.swap(deferred);
+    for (const Record& record : nested) Append(record.error, record.text);
+    if (bytes >= kThreadBufferBytes) Submit();
+  }
+
+  void Append(bool error, const std::string& text) {
+    if (lineOpen) {
+      deferred.push_back(Record{error, text});
+      return;
+    }
+    if (records.empty() || records.back().error != error) {
+      records.push_back(Record{error, std::string()});
+    }
+    records.back().text += text;
+    bytes += text.size();
+    if (bytes >= kThreadBufferBytes) Submit();
+  }
+
+  void Submit() {
+    if (records.empty() || lineOpen) return;
+    GetWriter().Push(std::move(records));
+    records.clear();
+    bytes = 0;
+  }
+};
+
+ThreadBuffer& GetThreadBuffer() {
+  thread_local ThreadBuffer buffer;
+  return buffer;
+}
+
+}  // namespace
+
+void Logger::SetLevel(LogLevel level) { maxLevel = static_cast<int>(level); }
+
+bool Logger::Enabled(LogLevel level) {
+  return static_cast<int>(level) <= maxLevel.load(std::memory_order_relaxed);
+}
+
+void Logger::FlushThread() { GetThreadBuffer().Submit(); }
+
+void Logger::Flush() {
+  FlushThread();
+  GetWriter().Wait();
+}
+
+Log::Log(LogLevel level) : level_(level) {
+  if (!Logger::Enabled(level)) return;
+  ThreadBuffer& buffer = GetThreadBuffer();
+  if (buffer.lineOpen) {
+    nested_.emplace();
+    stream_ = &*nested_;
+  } else {
+    stream_ = &buffer.BeginLine(level <= LogLevel::Warning);
+  }
+}
+
+Log::~Log() {
+  if (!stream_) return;
+  ThreadBuffer& buffer = GetThreadBuffer();
+  if (nested_) {
+    *nested_ << '\n';
+    buffer.Append(level_ <= LogLevel::Warning, nested_->str());
+  } else {
+    buffer.EndLine();
+  }
+}
+
+}  // namespace anysticker
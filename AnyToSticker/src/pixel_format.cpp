@@ -0,0 +1,113 @@
+#include "../include/pixel_format.h"
+
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace anysticker {
+
+namespace {
+
+inline uchar To8(uchar v) { return v; }
+inline uchar To8(uint16_t v) { return static_cast<uchar>((v + 128) / 257); }
+inline uchar To8(float v) {
+  return static_cast<uchar>(std::clamp(v * 255.0f + 0.5f, 0.0f, 255.0f));
+}
+
+// one pass over the image: channel expansion and depth reduction together
+template <typename T>
+void WidenRows(const cv::Mat& input, cv::Mat& output, const cv::Range& rows) {
+  const int channels = input.channels();
+  for (int y = rows.start; y < rows.end; ++y) {
+    const T* src = input.ptr<T>(y);
+    uchar* dst = output.ptr<uchar>(y);
+    for (int x = 0; x < input.cols; ++x, src += channels, dst += 4) {
+      switch (channels) {
+        case 1:
+          dst[0] = dst[1] = dst[2] = To8(src[0]);
+          dst[3] = 255;
+          break;
+        case 2:
+          dst[0] = dst[1] = dst[2] = To8(src[0]);
+          dst[3] = To8(src[1]);
+          break;
+        case 3:
+          dst[0] = To8(src[0]);
+          dst[1] = To8(src[1]);
+          dst[2] = To8(src[2]);
+          dst[3] = 255;
+          break;
+        default:
+          dst[0] = To8(src[0]);
+          dst[1] = To8(src[1]);
+          dst[2] = To8(src[2]);
+          dst[3] = To8(src[3]);
+          break;
+      }
+    }
+  }
+}
+
+// converts into an output that already has the right size and type
+bool ConvertInto(const cv::Mat& input, cv::Mat& output) {
+  const int channels = input.channels();
+  if (channels < 1 || channels > 4) return false;
+
+  // OpenCV's vectorized conversions cover the common 8-bit layouts
+  if (input.depth() == CV_8U && channels == 3) {
+    cv::cvtColor(input, output, cv::COLOR_BGR2BGRA);
+    return true;
+  }
+  if (input.depth() == CV_8U && channels == 1) {
+    cv::cvtColor(input, output, cv::COLOR_GRAY2BGRA);
+    return true;
+  }
+
+  cv::parallel_for_(cv::Range(0, input.rows), [&](const cv::Range& rows) {
+    switch (input.depth()) {
+      case CV_8U:
+        WidenRows<uchar>(input, output, rows);
+        break;
+      case CV_16U:
+        WidenRows<uint16_t>(input, output, rows);
+        break;
+      default:
+        WidenRows<float>(input, output, rows);
+        break;
+    }
+  });
+  return true;
+}
+
+bool IsSupportedDepth(int depth) {
+  return depth == CV_8U || depth == CV_16U || depth == CV_32F;
+}
+
+}  // namespace
+
+bool ConvertToBgra(const cv::Mat& input, cv::Mat& output) {
+  if (input.empty() || !IsSupportedDepth(input.depth())) return false;
+  if (input.type() == CV_8UC4) {
+    output = input;
+    return true;
+  }
+  output.create(input.rows, input.cols, CV_8UC4);
+  return ConvertInto(input, output);
+}
+
+cv::Mat ConvertToBgraPooled(const cv::Mat& input) {
+  if (input.empty() || !IsSupportedDepth(input.depth())) return cv::Mat();
+  if (input.type() == CV_8UC4) return input;
+
+  // the storage only grows, so a batch worker settles on the largest input
+  // instead of allocating a full-size buffer for every file
+  thread_local std::vector<uchar> storage;
+  storage.resize(std::max(storage.size(), input.total() * 4));
+  cv::Mat output(input.rows, input.cols, CV_8UC4, storage.data());
+  if (!ConvertInto(input, output)) return cv::Mat();
+  return output;
+}
+
+}  // namespace anysticker
@@ -0,0 +1,129 @@
+#include "../include/png_stream_reader.h"
+
+#include <png.h>
+
+#include <csetjmp>
+#include <cstring>
+
+namespace anysticker {
+
+PngStreamReader::PngStreamReader(const std::string& path,
+                                 const std::vector<uchar>* data)
+    : path_(path), data_(data) {}
+
+PngStreamReader::~PngStreamReader() {
+  if (png_) {
+    png_structp png = static_cast<png_structp>(png_);
+    png_infop info = static_cast<png_infop>(info_);
+    png_destroy_read_struct(&png, info ? &info : nullptr, nullptr);
+  }
+  if (file_) {
+    fclose(file_);
+  }
+}
+
+bool PngStreamReader::ReadMemory(uchar* out, size_t size) {
+  if (size > data_->size() - offset_) return false;
+  memcpy(out, data_->data() + offset_, size);
+  offset_ += size;
+  return true;
+}
+
+bool PngStreamReader::Open() {
+  png_byte signature[8];
+  if (data_) {
+    if (!ReadMemory(signature, sizeof(signature))) return false;
+  } else {
+#ifdef _WIN32
+    if (fopen_s(&file_, path_.c_str(), "rb") != 0 || file_ == nullptr) {
+      return false;
+    }
+#else
+    file_ = fopen(path_.c_str(), "rb");
+    if (file_ == nullptr) {
+      return false;
+    }
+#endif
+    if (fread(signature, 1, sizeof(signature), file_) != sizeof(signature)) {
+      return false;
+    }
+  }
+  if (png_sig_cmp(signature, 0, sizeof(signature)) != 0) {
+    return false;
+  }
+
+  png_structp png =
+      png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  if (!png) return false;
+  png_ = png;
+
+  png_infop info = png_create_info_struct(png);
+  if (!info) return false;
+  info_ = info;
+
+  // libpng reports errors with longjmp, keep this frame free of C++ objects
+  if (setjmp(png_jmpbuf(png))) {
+    return false;
+  }
+
+  if (data_) {
+    // libpng input callback over the file contents in memory
+    png_set_read_fn(png, this, [](png_structp png, png_bytep out,
+                                  png_size_t size) {
+      auto* reader = static_cast<PngStreamReader*>(png_get_io_ptr(png));
+      if (!reader->ReadMemory(out, size)) {
+        png_error(png, "unexpected end of png data");
+      }
+    });
+  } else {
+    png_init_io(png, file_);
+  }
+  png_set_sig_bytes(png, sizeof(signature));
+  png_read_info(png, info);
+
+  width_ = static_cast<int>(png_get_image_width(png, info));
+  height_ = static_cast<int>(png_get_image_height(png, info));
+  int colorType = png_get_color_type(png, info);
+  int bitDepth = png_get_bit_depth(png, info);
+  bool hasTrns = png_get_valid(png, info, PNG_INFO_tRNS) != 0;
+
+  // 16-bit and interlaced images keep using the in-memory path, so the result
+  // stays identical to what cv::imread would have produced
+  streamable_ = bitDepth <= 8 &&
+                png_get_interlace_type(png, info) == PNG_INTERLACE_NONE;
+
+  // map every layout to what ProcessImage ends up with after cv::imread and
+  // alpha insertion: plain gray stays single channel, everything else is BGRA
+  if (colorType == PNG_COLOR_TYPE_GRAY && !hasTrns) {
+    channels_ = 1;
+    if (bitDepth < 8) png_set_expand_gray_1_2_4_to_8(png);
+  } else {
+    channels_ = 4;
+    png_set_expand(png);
+    if (colorType == PNG_COLOR_TYPE_GRAY ||
+        colorType == PNG_COLOR_TYPE_GRAY_ALPHA) {
+      png_set_gray_to_rgb(png);
+    }
+    png_set_bgr(png);
+    if (!(colorType & PNG_COLOR_MASK_ALPHA) && !hasTrns) {
+      png_set_filler(png, 0xFF, PNG_FILLER_AFTER);
+    }
+  }
+
+  png_read_update_info(png, info);
+  return true;
+}
+
+bool PngStreamReader::ReadRow(uchar* row) {
+  png_structp png = static_cast<png_structp>(png_);
+  if (!png || !streamable_) return false;
+
+  if (setjmp(png_jmpbuf(png))) {
+    return false;
+  }
+
+  png_read_row(png, row, nullptr);
+  return true;
+}
+
+}  // namespace anysticker
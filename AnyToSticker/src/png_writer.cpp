@@ -0,0 +1,299 @@
+#include "../include/png_writer.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace anysticker {
+
+namespace {
+
+constexpr uchar kPngSignature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+
+// uncompressed bytes handled by one deflate job, the same block size pigz uses
+constexpr size_t kDeflateJobBytes = 128 * 1024;
+
+// each job is primed with this much preceding data, so matches can still
+// reach back across job boundaries and the ratio stays close to serial zlib
+constexpr size_t kDictionaryBytes = 32 * 1024;
+
+enum PngColorType { kGray = 0, kRgb = 2, kIndexed = 3, kRgba = 6 };
+
+void PutUint32(std::vector<uchar>& out, uint32_t value) {
+  out.push_back(static_cast<uchar>(value >> 24));
+  out.push_back(static_cast<uchar>(value >> 16));
+  out.push_back(static_cast<uchar>(value >> 8));
+  out.push_back(static_cast<uchar>(value));
+}
+
+void WriteChunk(std::vector<uchar>& out, const char* type, const uchar* data,
+                size_t size) {
+  PutUint32(out, static_cast<uint32_t>(size));
+  size_t typeOffset = out.size();
+  out.insert(out.end(), type, type + 4);
+  if (size > 0) {
+    out.insert(out.end(), data, data + size);
+  }
+  uLong crc = crc32(0L, &out[typeOffset], static_cast<uInt>(4 + size));
+  PutUint32(out, static_cast<uint32_t>(crc));
+}
+
+// convert one row from OpenCV channel order to png sample order
+void ConvertRow(const uchar* src, int width, int channels, uchar* dst) {
+  if (channels == 1) {
+    std::memcpy(dst, src, width);
+    return;
+  }
+  for (int x = 0; x < width; ++x) {
+    const uchar* p = src + x * channels;
+    uchar* q = dst + x * channels;
+    q[0] = p[2];
+    q[1] = p[1];
+    q[2] = p[0];
+    if (channels == 4) q[3] = p[3];
+  }
+}
+
+inline uchar Paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) return static_cast<uchar>(a);
+  if (pb <= pc) return static_cast<uchar>(b);
+  return static_cast<uchar>(c);
+}
+
+// apply all five png filters and keep the one with the smallest sum of
+// absolute signed residuals, the same heuristic libpng uses. palette indices
+// are not continuous tones, so indexed rows are stored unfiltered
+void FilterRow(const uchar* row, const uchar* prev, size_t rowBytes, int bpp,
+               bool adaptive, uchar* out, std::vector<uchar>& scratch) {
+  if (!adaptive) {
+    out[0] = 0;
+    std::memcpy(out + 1, row, rowBytes);
+    return;
+  }
+
+  scratch.resize(rowBytes * 5);
+  uchar* candidates[5];
+  for (int f = 0; f < 5; ++f) {
+    candidates[f] = &scratch[f * rowBytes];
+  }
+
+  for (size_t i = 0; i < rowBytes; ++i) {
+    int a = i >= static_cast<size_t>(bpp) ? row[i - bpp] : 0;
+    int b = prev ? prev[i] : 0;
+    int c = prev && i >= static_cast<size_t>(bpp) ? prev[i - bpp] : 0;
+    candidates[0][i] = row[i];
+    candidates[1][i] = static_cast<uchar>(row[i] - a);
+    candidates[2][i] = static_cast<uchar>(row[i] - b);
+    candidates[3][i] = static_cast<uchar>(row[i] - ((a + b) >> 1));
+    candidates[4][i] = static_cast<uchar>(row[i] - Paeth(a, b, c));
+  }
+
+  int best = 0;
+  uint64_t bestCost = UINT64_MAX;
+  for (int f = 0; f < 5; ++f) {
+    uint64_t cost = 0;
+    for (size_t i = 0; i < rowBytes; ++i) {
+      cost += std::abs(static_cast<signed char>(candidates[f][i]));
+    }
+    if (cost < bestCost) {
+      bestCost = cost;
+      best = f;
+    }
+  }
+
+  out[0] = static_cast<uchar>(best);
+  std::memcpy(out + 1, candidates[best], rowBytes);
+}
+
+// deflate one slice of the filtered stream as raw deflate; every slice but
+// the last ends with a full flush so the outputs can simply be concatenated
+bool DeflateSlice(const uchar* data, size_t begin, size_t end, bool last,
+                  int level, std::vector<uchar>& out) {
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, level, Z_DEFLATED, -MAX_WBITS, 9,
+                   Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+
+  if (begin > 0) {
+    size_t dictionaryBegin = begin > kDictionaryBytes ? begin - kDictionaryBytes
+                                                      : 0;
+    deflateSetDictionary(&stream, data + dictionaryBegin,
+                         static_cast<uInt>(begin - dictionaryBegin));
+  }
+
+  size_t length = end - begin;
+  out.resize(deflateBound(&stream, static_cast<uLong>(length)) + 16);
+  stream.next_in = const_cast<Bytef*>(data + begin);
+  stream.avail_in = static_cast<uInt>(length);
+  stream.next_out = out.data();
+  stream.avail_out = static_cast<uInt>(out.size());
+
+  int status = deflate(&stream, last ? Z_FINISH : Z_FULL_FLUSH);
+  bool ok = last ? status == Z_STREAM_END : status == Z_OK;
+  ok = ok && stream.avail_in == 0;
+  out.resize(out.size() - stream.avail_out);
+  deflateEnd(&stream);
+  return ok;
+}
+
+// shared by truecolor and indexed output: filter, deflate in parallel and
+// wrap everything into png chunks
+bool EncodeSamples(const cv::Mat& image, uchar colorType,
+                   const std::vector<uchar>& palette,
+                   const std::vector<uchar>& transparency, int level,
+                   int threads, std::vector<uchar>& buffer) {
+  const int channels = image.channels();
+  const bool adaptive = colorType != kIndexed;
+  const int width = image.cols, height = image.rows;
+  const size_t rowBytes = static_cast<size_t>(width) * channels;
+  const size_t filteredRowBytes = rowBytes + 1;
+  threads = std::max(1, threads);
+
+  // filtering only depends on the row above, so rows are converted and
+  // filtered in parallel bands first
+  std::vector<uchar> filtered(filteredRowBytes * height);
+  int filterBands = std::max(1, std::min(threads, height));
+  cv::parallel_for_(
+      cv::Range(0, filterBands),
+      [&](const cv::Range& range) {
+        std::vector<uchar> current(rowBytes), previous(rowBytes), scratch;
+        for (int band = range.start; band < range.end; ++band) {
+          int y0 = height * band / filterBands;
+          int y1 = height * (band + 1) / filterBands;
+          if (y0 > 0) {
+            ConvertRow(image.ptr<uchar>(y0 - 1), width, channels,
+                       previous.data());
+          }
+          for (int y = y0; y < y1; ++y) {
+            ConvertRow(image.ptr<uchar>(y), width, channels, current.data());
+            FilterRow(current.data(), y > 0 ? previous.data() : nullptr,
+                      rowBytes, channels, adaptive,
+                      &filtered[y * filteredRowBytes], scratch);
+            std::swap(current, previous);
+          }
+        }
+      },
+      filterBands);
+
+  // then the filtered stream is deflated in independent slices
+  size_t total = filtered.size();
+  int slices = static_cast<int>((total + kDeflateJobBytes - 1) /
+                                kDeflateJobBytes);
+  slices = std::max(1, slices);
+  std::vector<std::vector<uchar>> compressed(slices);
+  std::vector<uLong> checksums(slices);
+  std::vector<char> sliceOk(slices, 0);
+
+  cv::parallel_for_(
+      cv::Range(0, slices),
+      [&](const cv::Range& range) {
+        for (int i = range.start; i < range.end; ++i) {
+          size_t begin = i * kDeflateJobBytes;
+          size_t end = std::min(total, begin + kDeflateJobBytes);
+          sliceOk[i] = DeflateSlice(filtered.data(), begin, end,
+                                    i == slices - 1, level, compressed[i]);
+          checksums[i] = adler32(adler32(0L, Z_NULL, 0), &filtered[begin],
+                                 static_cast<uInt>(end - begin));
+        }
+      },
+      std::min(threads, slices));
+
+  for (char ok : sliceOk) {
+    if (!ok) return false;
+  }
+
+  // zlib stream: header, concatenated slices, combined adler32 trailer
+  std::vector<uchar> zlibStream;
+  int levelFlag = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+  uchar cmf = 0x78;
+  uchar flg = static_cast<uchar>(levelFlag << 6);
+  flg += static_cast<uchar>(31 - (cmf * 256 + flg) % 31);
+  zlibStream.push_back(cmf);
+  zlibStream.push_back(flg);
+
+  uLong adler = adler32(0L, Z_NULL, 0);
+  for (int i = 0; i < slices; ++i) {
+    zlibStream.insert(zlibStream.end(), compressed[i].begin(),
+                      compressed[i].end());
+    size_t begin = i * kDeflateJobBytes;
+    size_t length = std::min(total, begin + kDeflateJobBytes) - begin;
+    adler = adler32_combine(adler, checksums[i], static_cast<z_off_t>(length));
+  }
+  PutUint32(zlibStream, static_cast<uint32_t>(adler));
+
+  uchar header[13];
+  header[0] = static_cast<uchar>(width >> 24);
+  header[1] = static_cast<uchar>(width >> 16);
+  header[2] = static_cast<uchar>(width >> 8);
+  header[3] = static_cast<uchar>(width);
+  header[4] = static_cast<uchar>(height >> 24);
+  header[5] = static_cast<uchar>(height >> 16);
+  header[6] = static_cast<uchar>(height >> 8);
+  header[7] = static_cast<uchar>(height);
+  header[8] = 8;  // bit depth
+  header[9] = colorType;
+  header[10] = 0;  // deflate
+  header[11] = 0;  // adaptive filtering
+  header[12] = 0;  // no interlace
+
+  buffer.clear();
+  buffer.reserve(zlibStream.size() + 64);
+  buffer.insert(buffer.end(), kPngSignature, kPngSignature + 8);
+  WriteChunk(buffer, "IHDR", header, sizeof(header));
+  if (!palette.empty()) {
+    WriteChunk(buffer, "PLTE", palette.data(), palette.size());
+  }
+  if (!transparency.empty()) {
+    WriteChunk(buffer, "tRNS", transparency.data(), transparency.size());
+  }
+  WriteChunk(buffer, "IDAT", zlibStream.data(), zlibStream.size());
+  WriteChunk(buffer, "IEND", nullptr, 0);
+  return true;
+}
+
+}  // namespace
+
+bool EncodePng(const cv::Mat& image, int level, int threads,
+               std::vector<uchar>& buffer) {
+  const int channels = image.channels();
+  if (image.empty() || image.depth() != CV_8U ||
+      (channels != 1 && channels != 3 && channels != 4)) {
+    return false;
+  }
+
+  uchar colorType = channels == 1 ? kGray : channels == 3 ? kRgb : kRgba;
+  return EncodeSamples(image, colorType, {}, {}, level, threads, buffer);
+}
+
+bool EncodeIndexedPng(const cv::Mat& indices,
+                      const std::vector<cv::Vec4b>& palette, int level,
+                      int threads, std::vector<uchar>& buffer) {
+  if (indices.empty() || indices.type() != CV_8UC1 || palette.empty() ||
+      palette.size() > 256) {
+    return false;
+  }
+
+  // PLTE holds RGB triplets, tRNS the alpha values up to the last entry
+  // that is not fully opaque
+  std::vector<uchar> rgb, alpha;
+  size_t lastTranslucent = 0;
+  for (size_t i = 0; i < palette.size(); ++i) {
+    rgb.push_back(palette[i][2]);
+    rgb.push_back(palette[i][1]);
+    rgb.push_back(palette[i][0]);
+    alpha.push_back(palette[i][3]);
+    if (palette[i][3] != 255) lastTranslucent = i + 1;
+  }
+  alpha.resize(lastTranslucent);
+
+  return EncodeSamples(indices, kIndexed, rgb, alpha, level, threads, buffer);
+}
+
+}  // namespace anysticker
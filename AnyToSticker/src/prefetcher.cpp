@@ -0,0 +1,79 @@
+#include "../include/prefetcher.h"
+
+#include <fcntl.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+namespace anysticker {
+
+namespace {
+
+// posix_fadvise only queues the request, readahead runs in the background
+// and the pages stay cached after the descriptor is closed
+void Advise(const fs::path& path, int advice) {
+#ifdef POSIX_FADV_WILLNEED
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  posix_fadvise(fd, 0, 0, advice);
+  close(fd);
+#else
+  (void)path;
+  (void)advice;
+#endif
+}
+
+}  // namespace
+
+Prefetcher::Prefetcher(const std::vector<fs::path>& files, size_t aheadBytes)
+    : files_(files), aheadBytes_(aheadBytes), sizes_(files.size(), 0) {}
+
+void Prefetcher::Started(size_t index) {
+#ifdef POSIX_FADV_WILLNEED
+  HintAhead(index);
+#else
+  (void)index;
+#endif
+}
+
+void Prefetcher::Finished(size_t index) {
+#ifdef POSIX_FADV_DONTNEED
+  Advise(files_[index], POSIX_FADV_DONTNEED);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pendingBytes_ -= sizes_[index];
+  }
+  // the freed budget goes to the files after the current window
+  HintAhead(index);
+#else
+  (void)index;
+#endif
+}
+
+void Prefetcher::HintAhead(size_t index) {
+#ifdef POSIX_FADV_WILLNEED
+  // pick the files under the lock, advise outside of it
+  std::vector<size_t> picked;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (hinted_ < files_.size()) {
+      std::error_code error;
+      uintmax_t size = fs::file_size(files_[hinted_], error);
+      if (error) size = 0;
+      if (hinted_ > index && pendingBytes_ + size > aheadBytes_) break;
+      sizes_[hinted_] = size;
+      pendingBytes_ += size;
+      picked.push_back(hinted_++);
+    }
+  }
+  for (size_t i : picked) {
+    Advise(files_[i], POSIX_FADV_WILLNEED);
+  }
+#else
+  (void)index;
+#endif
+}
+
+}  // namespace anysticker
@@ -0,0 +1,186 @@
+#include "../include/profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+
+#include "../include/logger.h"
+
+namespace anysticker {
+
+namespace {
+
+constexpr size_t kStageCount = static_cast<size_t>(Stage::COUNT);
+
+const char* const kStageNames[kStageCount] = {
+    "read",      "decode", "convert", "trim",  "resize",
+    "remove-bg", "encode", "write",   "total",
+};
+
+std::atomic<bool> enabled{false};
+
+struct Samples {
+  std::vector<int64_t> durations[kStageCount];  // nanoseconds
+};
+
+// samples of finished threads, plus the threads still recording
+struct Registry {
+  std::mutex mutex;
+  std::vector<Samples*> live;
+  Samples retired;
+};
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+// registers itself on a thread's first sample and hands its samples over
+// when the thread exits, so batch workers never share a lock while timing
+struct ThreadSamples : Samples {
+  ThreadSamples() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.live.push_back(this);
+  }
+
+  ~ThreadSamples() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (size_t i = 0; i < kStageCount; ++i) {
+      registry.retired.durations[i].insert(registry.retired.durations[i].end(),
+                                           durations[i].begin(),
+                                           durations[i].end());
+    }
+    registry.live.erase(
+        std::find(registry.live.begin(), registry.live.end(), this));
+  }
+};
+
+// nearest-rank percentile of sorted samples, in milliseconds
+double Percentile(const std::vector<int64_t>& sorted, double fraction) {
+  size_t rank = static_cast<size_t>(std::ceil(fraction * sorted.size()));
+  return sorted[std::max<size_t>(rank, 1) - 1] / 1e6;
+}
+
+// stage totals of the input the current thread is working on
+struct InputTimes {
+  int depth = 0;
+  StageTimes totals{};
+};
+
+InputTimes& GetInputTimes() {
+  thread_local InputTimes times;
+  return times;
+}
+
+}  // namespace
+
+void Profiler::Enable() { enabled = true; }
+
+bool Profiler::Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+void Profiler::Record(Stage stage, std::chrono::nanoseconds duration) {
+  thread_local ThreadSamples samples;
+  samples.durations[static_cast<size_t>(stage)].push_back(duration.count());
+  GetInputTimes().totals[static_cast<size_t>(stage)] += duration.count() / 1e6;
+}
+
+void Profiler::BeginInput() {
+  InputTimes& times = GetInputTimes();
+  if (times.depth++ == 0) times.totals.fill(0);
+}
+
+void Profiler::AddInputTime(Stage stage, std::chrono::nanoseconds duration) {
+  if (!Enabled()) return;
+  GetInputTimes().totals[static_cast<size_t>(stage)] += duration.count() / 1e6;
+}
+
+StageTimes Profiler::EndInput() {
+  InputTimes& times = GetInputTimes();
+  if (times.depth > 0) --times.depth;
+  return times.totals;
+}
+
+std::vector<StageStats> Profiler::Collect() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+
+  std::vector<StageStats> stats;
+  for (size_t i = 0; i < kStageCount; ++i) {
+    std::vector<int64_t> all = registry.retired.durations[i];
+    for (const Samples* samples : registry.live) {
+      all.insert(all.end(), samples->durations[i].begin(),
+                 samples->durations[i].end());
+    }
+    if (all.empty()) continue;
+    std::sort(all.begin(), all.end());
+
+    StageStats stage;
+    stage.stage = static_cast<Stage>(i);
+    stage.count = all.size();
+    for (int64_t duration : all) {
+      stage.totalMs += duration / 1e6;
+    }
+    stage.p50Ms = Percentile(all, 0.50);
+    stage.p95Ms = Percentile(all, 0.95);
+    stage.p99Ms = Percentile(all, 0.99);
+    stage.maxMs = all.back() / 1e6;
+    stats.push_back(stage);
+  }
+  return stats;
+}
+
+void Profiler::PrintReport(const std::vector<StageStats>& stats,
+                           double wallSeconds) {
+  std::cout << "\nProfile (wall time " << std::fixed << std::setprecision(3)
+            << wallSeconds << " s, stage times summed over threads)\n";
+  std::cout << std::left << std::setw(12) << "stage" << std::right
+            << std::setw(8) << "count" << std::setw(12) << "total(ms)"
+            << std::setw(10) << "p50" << std::setw(10) << "p95"
+            << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+  for (const StageStats& stage : stats) {
+    std::cout << std::left << std::setw(12) << StageName(stage.stage)
+              << std::right << std::setw(8) << stage.count << std::fixed
+              << std::setprecision(1) << std::setw(12) << stage.totalMs
+              << std::setprecision(2) << std::setw(10) << stage.p50Ms
+              << std::setw(10) << stage.p95Ms << std::setw(10) << stage.p99Ms
+              << std::setw(10) << stage.maxMs << "\n";
+  }
+  std::cout << std::flush;
+}
+
+bool Profiler::WriteJson(const std::string& path,
+                         const std::vector<StageStats>& stats,
+                         double wallSeconds) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    Log(LogLevel::Error) << "Error: cannot write profile to " << path;
+    return false;
+  }
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\"wall_ms\": " << wallSeconds * 1000 << ", \"stages\": [";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    const StageStats& stage = stats[i];
+    file << (i ? ", " : "") << "{\"stage\": \"" << StageName(stage.stage)
+         << "\", \"count\": " << stage.count
+         << ", \"total_ms\": " << stage.totalMs
+         << ", \"p50_ms\": " << stage.p50Ms << ", \"p95_ms\": " << stage.p95Ms
+         << ", \"p99_ms\": " << stage.p99Ms << ", \"max_ms\": " << stage.maxMs
+         << "}";
+  }
+  file << "]}\n";
+  return static_cast<bool>(file.flush());
+}
+
+const char* Profiler::StageName(Stage stage) {
+  size_t index = static_cast<size_t>(stage);
+  return index < kStageCount ? kStageNames[index] : "unknown";
+}
+
+}  // namespace anysticker
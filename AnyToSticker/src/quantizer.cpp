@@ -0,0 +1,452 @@
+#include "../include/quantizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <unordered_map>
+
+namespace anysticker {
+
+namespace {
+
+// histogram bins and the nearest-color cache keep 5 bits per channel
+constexpr int kKeyShift = 3;
+constexpr size_t kKeyCount = size_t(1) << 20;
+
+// larger images are sampled on a regular grid while building the histogram
+constexpr size_t kMaxSamples = 512 * 512;
+
+constexpr int kKMeansIterations = 4;
+
+// alpha errors show up as halos around the sticker, weigh them higher
+constexpr float kAlphaWeight = 2.0f;
+
+// never produced by PackPixel, fully transparent pixels pack to 0
+constexpr uint32_t kNoColor = 1;
+
+inline uint32_t PackPixel(const uchar* p, int channels) {
+  uint32_t alpha = channels == 4 ? p[3] : 255;
+  if (alpha == 0) return 0;
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (alpha << 24);
+}
+
+inline cv::Vec4b UnpackColor(uint32_t color) {
+  return cv::Vec4b(static_cast<uchar>(color), static_cast<uchar>(color >> 8),
+                   static_cast<uchar>(color >> 16),
+                   static_cast<uchar>(color >> 24));
+}
+
+inline uint32_t ColorKey(int b, int g, int r, int a) {
+  return (b >> kKeyShift) | ((g >> kKeyShift) << 5) |
+         ((r >> kKeyShift) << 10) | ((a >> kKeyShift) << 15);
+}
+
+inline bool IsTranslucent(const cv::Vec4b& color) { return color[3] != 255; }
+
+// colors with alpha < 255 go first, so tRNS only covers a prefix of PLTE
+void SortPalette(std::vector<cv::Vec4b>& palette) {
+  std::stable_sort(palette.begin(), palette.end(),
+                   [](const cv::Vec4b& a, const cv::Vec4b& b) {
+                     return IsTranslucent(a) && !IsTranslucent(b);
+                   });
+}
+
+// images that already fit the palette are mapped exactly, without any loss
+bool QuantizeExact(const cv::Mat& image, int maxColors,
+                   PaletteImage& result) {
+  const int channels = image.channels();
+  std::unordered_map<uint32_t, int> lookup;
+  lookup.reserve(maxColors * 2);
+
+  uint32_t last = kNoColor;
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr<uchar>(y);
+    for (int x = 0; x < image.cols; ++x) {
+      uint32_t color = PackPixel(row + x * channels, channels);
+      if (color == last) continue;
+      last = color;
+      if (lookup.emplace(color, 0).second &&
+          lookup.size() > static_cast<size_t>(maxColors)) {
+        return false;
+      }
+    }
+  }
+
+  result.palette.clear();
+  for (const auto& entry : lookup) {
+    result.palette.push_back(UnpackColor(entry.first));
+  }
+  std::sort(result.palette.begin(), result.palette.end(),
+            [](const cv::Vec4b& a, const cv::Vec4b& b) {
+              return std::lexicographical_compare(a.val, a.val + 4, b.val,
+                                                  b.val + 4);
+            });
+  SortPalette(result.palette);
+  for (size_t i = 0; i < result.palette.size(); ++i) {
+    const cv::Vec4b& c = result.palette[i];
+    lookup[c[0] | (c[1] << 8) | (c[2] << 16) | (uint32_t(c[3]) << 24)] =
+        static_cast<int>(i);
+  }
+
+  result.indices.create(image.rows, image.cols, CV_8UC1);
+  last = kNoColor;
+  uchar lastIndex = 0;
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr<uchar>(y);
+    uchar* out = result.indices.ptr<uchar>(y);
+    for (int x = 0; x < image.cols; ++x) {
+      uint32_t color = PackPixel(row + x * channels, channels);
+      if (color != last) {
+        last = color;
+        lastIndex = static_cast<uchar>(lookup[color]);
+      }
+      out[x] = lastIndex;
+    }
+  }
+  return true;
+}
+
+// weighted color samples, one per histogram bin, stored as separate arrays
+// so the k-means distance loop stays simple and vectorizable
+struct Samples {
+  std::vector<float> b, g, r, a, weight;
+
+  size_t Size() const { return weight.size(); }
+
+  float Channel(int c, size_t i) const {
+    return c == 0 ? b[i] : c == 1 ? g[i] : c == 2 ? r[i] : a[i];
+  }
+};
+
+struct Centroid {
+  float b = 0, g = 0, r = 0, a = 0;
+};
+
+inline float Distance(const Centroid& c, float b, float g, float r, float a) {
+  float db = c.b - b, dg = c.g - g, dr = c.r - r, da = c.a - a;
+  return db * db + dg * dg + dr * dr + kAlphaWeight * da * da;
+}
+
+int Nearest(const std::vector<Centroid>& centroids, float b, float g, float r,
+            float a) {
+  int best = 0;
+  float bestDistance = FLT_MAX;
+  for (size_t i = 0; i < centroids.size(); ++i) {
+    float d = Distance(centroids[i], b, g, r, a);
+    if (d < bestDistance) {
+      bestDistance = d;
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+bool HasTransparentPixels(const cv::Mat& image) {
+  if (image.channels() != 4) return false;
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr<uchar>(y);
+    for (int x = 0; x < image.cols; ++x) {
+      if (row[x * 4 + 3] == 0) return true;
+    }
+  }
+  return false;
+}
+
+// histogram of the visible pixels; fully transparent pixels get a dedicated
+// palette entry instead of a bin
+void BuildHistogram(const cv::Mat& image, int step, Samples& samples) {
+  const int channels = image.channels();
+  std::unordered_map<uint32_t, size_t> bins;
+  for (int y = 0; y < image.rows; y += step) {
+    const uchar* row = image.ptr<uchar>(y);
+    for (int x = 0; x < image.cols; x += step) {
+      const uchar* p = row + x * channels;
+      int alpha = channels == 4 ? p[3] : 255;
+      if (alpha == 0) continue;
+      uint32_t key = ColorKey(p[0], p[1], p[2], alpha);
+      auto found = bins.emplace(key, samples.Size());
+      if (found.second) {
+        samples.b.push_back(0);
+        samples.g.push_back(0);
+        samples.r.push_back(0);
+        samples.a.push_back(0);
+        samples.weight.push_back(0);
+      }
+      size_t i = found.first->second;
+      samples.b[i] += p[0];
+      samples.g[i] += p[1];
+      samples.r[i] += p[2];
+      samples.a[i] += static_cast<float>(alpha);
+      samples.weight[i] += 1;
+    }
+  }
+
+  for (size_t i = 0; i < samples.Size(); ++i) {
+    samples.b[i] /= samples.weight[i];
+    samples.g[i] /= samples.weight[i];
+    samples.r[i] /= samples.weight[i];
+    samples.a[i] /= samples.weight[i];
+  }
+}
+
+void BuildHistogram(const cv::Mat& image, Samples& samples) {
+  size_t pixels = image.total();
+  int step = 1;
+  while (pixels / (static_cast<size_t>(step) * step) > kMaxSamples) ++step;
+  BuildHistogram(image, step, samples);
+  // the grid can miss every visible pixel of a mostly transparent image
+  if (samples.Size() == 0 && step > 1) BuildHistogram(image, 1, samples);
+}
+
+// median cut: repeatedly split the box with the largest weighted extent at
+// the weighted median of its widest channel
+std::vector<Centroid> MedianCut(const Samples& samples, int colors) {
+  struct Box {
+    size_t begin, end;
+    int channel;
+    float score;
+  };
+
+  std::vector<size_t> order(samples.Size());
+  for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+
+  auto measure = [&](Box& box) {
+    float low[4] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+    float high[4] = {0, 0, 0, 0};
+    float weight = 0;
+    for (size_t k = box.begin; k < box.end; ++k) {
+      for (int c = 0; c < 4; ++c) {
+        float v = samples.Channel(c, order[k]);
+        low[c] = std::min(low[c], v);
+        high[c] = std::max(high[c], v);
+      }
+      weight += samples.weight[order[k]];
+    }
+    box.channel = 0;
+    float widest = -1;
+    for (int c = 0; c < 4; ++c) {
+      float extent = (high[c] - low[c]) * (c == 3 ? kAlphaWeight : 1.0f);
+      if (extent > widest) {
+        widest = extent;
+        box.channel = c;
+      }
+    }
+    box.score = box.end - box.begin > 1 ? widest * weight : -1;
+  };
+
+  std::vector<Box> boxes(1);
+  boxes[0].begin = 0;
+  boxes[0].end = order.size();
+  measure(boxes[0]);
+
+  while (static_cast<int>(boxes.size()) < colors) {
+    auto target = std::max_element(
+        boxes.begin(), boxes.end(),
+        [](const Box& a, const Box& b) { return a.score < b.score; });
+    if (target->score < 0) break;
+
+    Box box = *target;
+    std::sort(order.begin() + box.begin, order.begin() + box.end,
+              [&](size_t a, size_t b) {
+                return samples.Channel(box.channel, a) <
+                       samples.Channel(box.channel, b);
+              });
+
+    float total = 0;
+    for (size_t k = box.begin; k < box.end; ++k) {
+      total += samples.weight[order[k]];
+    }
+    float running = 0;
+    size_t split = box.begin + 1;
+    for (size_t k = box.begin; k < box.end - 1; ++k) {
+      running += samples.weight[order[k]];
+      split = k + 1;
+      if (running >= total / 2) break;
+    }
+
+    Box lower = box, upper = box;
+    lower.end = split;
+    upper.begin = split;
+    measure(lower);
+    measure(upper);
+    *target = lower;
+    boxes.push_back(upper);
+  }
+
+  std::vector<Centroid> centroids;
+  for (const Box& box : boxes) {
+    Centroid c;
+    float weight = 0;
+    for (size_t k = box.begin; k < box.end; ++k) {
+      size_t i = order[k];
+      float w = samples.weight[i];
+      c.b += samples.b[i] * w;
+      c.g += samples.g[i] * w;
+      c.r += samples.r[i] * w;
+      c.a += samples.a[i] * w;
+      weight += w;
+    }
+    if (weight <= 0) continue;
+    c.b /= weight;
+    c.g /= weight;
+    c.r /= weight;
+    c.a /= weight;
+    centroids.push_back(c);
+  }
+  return centroids;
+}
+
+// a few weighted Lloyd iterations over the histogram bins
+void RefineCentroids(const Samples& samples,
+                     std::vector<Centroid>& centroids) {
+  std::vector<Centroid> sums(centroids.size());
+  std::vector<float> weights(centroids.size());
+  for (int iteration = 0; iteration < kKMeansIterations; ++iteration) {
+    std::fill(sums.begin(), sums.end(), Centroid());
+    std::fill(weights.begin(), weights.end(), 0.0f);
+    for (size_t i = 0; i < samples.Size(); ++i) {
+      int n = Nearest(centroids, samples.b[i], samples.g[i], samples.r[i],
+                      samples.a[i]);
+      float w = samples.weight[i];
+      sums[n].b += samples.b[i] * w;
+      sums[n].g += samples.g[i] * w;
+      sums[n].r += samples.r[i] * w;
+      sums[n].a += samples.a[i] * w;
+      weights[n] += w;
+    }
+    for (size_t n = 0; n < centroids.size(); ++n) {
+      if (weights[n] <= 0) continue;  // keep empty clusters where they are
+      centroids[n].b = sums[n].b / weights[n];
+      centroids[n].g = sums[n].g / weights[n];
+      centroids[n].r = sums[n].r / weights[n];
+      centroids[n].a = sums[n].a / weights[n];
+    }
+  }
+}
+
+inline uchar ToByte(float value) {
+  return static_cast<uchar>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+}
+
+// map every pixel to the palette. lookups are cached per 5-bit key, and with
+// dithering the color error is diffused Floyd-Steinberg style in serpentine
+// order; alpha is never dithered, that only adds noise to the outline
+void MapPixels(const cv::Mat& image, bool dither, int transparentIndex,
+               PaletteImage& result) {
+  const int channels = image.channels();
+  const int width = image.cols;
+
+  std::vector<Centroid> palette(result.palette.size());
+  for (size_t i = 0; i < palette.size(); ++i) {
+    palette[i].b = result.palette[i][0];
+    palette[i].g = result.palette[i][1];
+    palette[i].r = result.palette[i][2];
+    palette[i].a = result.palette[i][3];
+  }
+
+  // the dedicated transparent entry is only used for fully transparent input
+  std::vector<Centroid> candidates = palette;
+  if (transparentIndex >= 0) {
+    candidates[transparentIndex].a = 1e6f;
+  }
+
+  std::vector<int16_t> cache(kKeyCount, -1);
+  std::vector<float> current, next;
+  if (dither) {
+    current.assign((width + 2) * 3, 0.0f);
+    next.assign((width + 2) * 3, 0.0f);
+  }
+
+  result.indices.create(image.rows, width, CV_8UC1);
+  for (int y = 0; y < image.rows; ++y) {
+    const uchar* row = image.ptr<uchar>(y);
+    uchar* out = result.indices.ptr<uchar>(y);
+    bool reverse = dither && (y & 1);
+    for (int i = 0; i < width; ++i) {
+      int x = reverse ? width - 1 - i : i;
+      const uchar* p = row + x * channels;
+      int alpha = channels == 4 ? p[3] : 255;
+      if (alpha == 0 && transparentIndex >= 0) {
+        out[x] = static_cast<uchar>(transparentIndex);
+        continue;
+      }
+
+      float color[3] = {static_cast<float>(p[0]), static_cast<float>(p[1]),
+                        static_cast<float>(p[2])};
+      if (dither) {
+        for (int c = 0; c < 3; ++c) {
+          color[c] = std::clamp(color[c] + current[(x + 1) * 3 + c], 0.0f,
+                                255.0f);
+        }
+      }
+
+      uint32_t key = ColorKey(ToByte(color[0]), ToByte(color[1]),
+                              ToByte(color[2]), alpha);
+      int index = cache[key];
+      if (index < 0) {
+        index = Nearest(candidates, color[0], color[1], color[2],
+                        static_cast<float>(alpha));
+        cache[key] = static_cast<int16_t>(index);
+      }
+      out[x] = static_cast<uchar>(index);
+
+      if (dither) {
+        int forward = reverse ? -1 : 1;
+        const Centroid& chosen = palette[index];
+        float error[3] = {color[0] - chosen.b, color[1] - chosen.g,
+                          color[2] - chosen.r};
+        for (int c = 0; c < 3; ++c) {
+          current[(x + 1 + forward) * 3 + c] += error[c] * 7 / 16;
+          next[(x + 1 - forward) * 3 + c] += error[c] * 3 / 16;
+          next[(x + 1) * 3 + c] += error[c] * 5 / 16;
+          next[(x + 1 + forward) * 3 + c] += error[c] * 1 / 16;
+        }
+      }
+    }
+    if (dither) {
+      std::swap(current, next);
+      std::fill(next.begin(), next.end(), 0.0f);
+    }
+  }
+}
+
+}  // namespace
+
+bool QuantizeImage(const cv::Mat& image, int maxColors, bool dither,
+                   PaletteImage& result) {
+  const int channels = image.channels();
+  if (image.empty() || image.depth() != CV_8U ||
+      (channels != 3 && channels != 4)) {
+    return false;
+  }
+  maxColors = std::clamp(maxColors, 2, 256);
+
+  if (QuantizeExact(image, maxColors, result)) {
+    return true;
+  }
+
+  Samples samples;
+  BuildHistogram(image, samples);
+  bool transparent = HasTransparentPixels(image);
+  int visibleColors = transparent ? maxColors - 1 : maxColors;
+
+  std::vector<Centroid> centroids = MedianCut(samples, visibleColors);
+  if (centroids.empty()) return false;
+  RefineCentroids(samples, centroids);
+
+  result.palette.clear();
+  if (transparent) {
+    result.palette.push_back(cv::Vec4b(0, 0, 0, 0));
+  }
+  for (const Centroid& c : centroids) {
+    result.palette.push_back(
+        cv::Vec4b(ToByte(c.b), ToByte(c.g), ToByte(c.r), ToByte(c.a)));
+  }
+  SortPalette(result.palette);
+
+  // the transparent entry stays first after the stable sort
+  MapPixels(image, dither, transparent ? 0 : -1, result);
+  return true;
+}
+
+}  // namespace anysticker
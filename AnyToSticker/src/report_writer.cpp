@@ -0,0 +1,103 @@
+#include "../include/report_writer.h"
+
+#include <cstdio>
+#include <sstream>
+
+#include "../include/logger.h"
+
+namespace anysticker {
+
+namespace {
+
+// a JSON string literal; paths are written byte for byte, only quotes,
+// backslashes and control characters are escaped
+std::string QuoteJson(const std::string& value) {
+  std::string out = "\"";
+  for (char c : value) {
+    switch (c) {
+      case '"':
+        out += "\\\"";
+        break;
+      case '\\':
+        out += "\\\\";
+        break;
+      case '\n':
+        out += "\\n";
+        break;
+      case '\r':
+        out += "\\r";
+        break;
+      case '\t':
+        out += "\\t";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char escaped[8];
+          snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+          out += escaped;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out + "\"";
+}
+
+}  // namespace
+
+std::string FormatReportRecord(const ProcessingResult& result) {
+  std::ostringstream record;
+  record << "{\"input\": " << QuoteJson(result.inputPath)
+         << ", \"output\": " << QuoteJson(result.outputPath)
+         << ", \"extra_outputs\": [";
+  for (size_t i = 0; i < result.extraOutputPaths.size(); ++i) {
+    record << (i ? ", " : "") << QuoteJson(result.extraOutputPaths[i]);
+  }
+  record << "], \"success\": " << (result.success ? "true" : "false")
+         << ", \"error_code\": \"" << ErrorCodeName(result.errorCode)
+         << "\", \"error\": " << QuoteJson(result.error)
+         << ", \"input_bytes\": " << result.inputBytes
+         << ", \"output_bytes\": " << result.outputBytes
+         << ", \"input_width\": " << result.inputSize.width
+         << ", \"input_height\": " << result.inputSize.height
+         << ", \"output_width\": " << result.outputSize.width
+         << ", \"output_height\": " << result.outputSize.height
+         << ", \"frames\": " << result.frames
+         << ", \"encode_passes\": " << result.encodePasses
+         << ", \"stages_ms\": {";
+
+  // every stage is listed so all records share one schema
+  record.setf(std::ios::fixed);
+  record.precision(3);
+  for (size_t i = 0; i < result.stageMs.size(); ++i) {
+    record << (i ? ", " : "") << "\""
+           << Profiler::StageName(static_cast<Stage>(i))
+           << "\": " << result.stageMs[i];
+  }
+  record << "}}";
+  return record.str();
+}
+
+ReportWriter::ReportWriter(const std::string& path) : path_(path) {}
+
+bool ReportWriter::Open() {
+  file_.open(path_, std::ios::binary | std::ios::trunc);
+  if (!file_) {
+    Log(LogLevel::Error) << "Error: cannot write report to " << path_;
+    return false;
+  }
+  return true;
+}
+
+bool ReportWriter::Write(const ProcessingResult& result) {
+  // formatted outside the lock, the workers only serialize on the write
+  std::string line = FormatReportRecord(result) + "\n";
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.write(line.data(), static_cast<std::streamsize>(line.size()));
+  // flushed per record so a dashboard tailing the file sees it right away
+  file_.flush();
+  return static_cast<bool>(file_);
+}
+
+}  // namespace anysticker
@@ -0,0 +1,410 @@
+#include "../include/resampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <utility>
+
+namespace anysticker {
+
+namespace {
+
+// bands shorter than this spend more time on halo rows than they save
+constexpr int kMinBandRows = 32;
+constexpr double kPi = 3.14159265358979323846;
+
+// inverse table resolution: 14 bits keeps the darkest sRGB codes distinct
+constexpr int kLinearSteps = 1 << 14;
+
+// sRGB <-> linear light conversion tables, linear values are kept in the
+// same [0, 255] range as the 8-bit path so both share the resampling code
+struct SrgbTables {
+  float toLinear[256];
+  uchar fromLinear[kLinearSteps + 1];
+};
+
+const SrgbTables& GetSrgbTables() {
+  static const SrgbTables tables = [] {
+    SrgbTables t;
+    for (int i = 0; i < 256; ++i) {
+      double v = i / 255.0;
+      v = v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+      t.toLinear[i] = static_cast<float>(v * 255.0);
+    }
+    for (int i = 0; i <= kLinearSteps; ++i) {
+      double v = static_cast<double>(i) / kLinearSteps;
+      v = v <= 0.0031308 ? v * 12.92 : 1.055 * std::pow(v, 1 / 2.4) - 0.055;
+      t.fromLinear[i] = cv::saturate_cast<uchar>(v * 255.0);
+    }
+    return t;
+  }();
+  return tables;
+}
+
+double Sinc(double x) {
+  if (std::abs(x) < 1e-7) return 1.0;
+  double px = kPi * x;
+  return std::sin(px) / px;
+}
+
+double Lanczos(double x, double a) {
+  if (std::abs(x) >= a) return 0.0;
+  return Sinc(x) * Sinc(x / a);
+}
+
+// two-parameter cubic family: (B, C) = (0, 0.75) is the OpenCV bicubic
+// kernel, (1/3, 1/3) is Mitchell-Netravali
+double Cubic(double x, double b, double c) {
+  x = std::abs(x);
+  if (x < 1.0) {
+    return ((12 - 9 * b - 6 * c) * x * x * x + (-18 + 12 * b + 6 * c) * x * x +
+            (6 - 2 * b)) /
+           6.0;
+  }
+  if (x < 2.0) {
+    return ((-b - 6 * c) * x * x * x + (6 * b + 30 * c) * x * x +
+            (-12 * b - 48 * c) * x + (8 * b + 24 * c)) /
+           6.0;
+  }
+  return 0.0;
+}
+
+double KernelRadius(ResizeFilter filter) {
+  switch (filter) {
+    case ResizeFilter::AREA:
+    case ResizeFilter::BILINEAR:
+      return 1.0;
+    case ResizeFilter::BICUBIC:
+    case ResizeFilter::MITCHELL:
+      return 2.0;
+    case ResizeFilter::LANCZOS3:
+      return 3.0;
+    case ResizeFilter::LANCZOS4:
+    default:
+      return 4.0;
+  }
+}
+
+double Kernel(ResizeFilter filter, double x) {
+  switch (filter) {
+    case ResizeFilter::AREA:
+    case ResizeFilter::BILINEAR:
+      return std::max(0.0, 1.0 - std::abs(x));
+    case ResizeFilter::BICUBIC:
+      return Cubic(x, 0.0, 0.75);
+    case ResizeFilter::MITCHELL:
+      return Cubic(x, 1.0 / 3.0, 1.0 / 3.0);
+    case ResizeFilter::LANCZOS3:
+      return Lanczos(x, 3.0);
+    case ResizeFilter::LANCZOS4:
+    default:
+      return Lanczos(x, 4.0);
+  }
+}
+
+const std::pair<ResizeFilter, const char*> kFilterNames[] = {
+    {ResizeFilter::AREA, "area"},         {ResizeFilter::BILINEAR, "bilinear"},
+    {ResizeFilter::BICUBIC, "bicubic"},   {ResizeFilter::LANCZOS3, "lanczos3"},
+    {ResizeFilter::LANCZOS4, "lanczos4"}, {ResizeFilter::MITCHELL, "mitchell"},
+};
+
+}  // namespace
+
+const char* ResizeFilterName(ResizeFilter filter) {
+  for (const auto& entry : kFilterNames) {
+    if (entry.first == filter) return entry.second;
+  }
+  return "unknown";
+}
+
+bool ParseResizeFilter(const std::string& name, ResizeFilter& filter) {
+  for (const auto& entry : kFilterNames) {
+    if (name == entry.second) {
+      filter = entry.first;
+      return true;
+    }
+  }
+  return false;
+}
+
+ResampleAxis ResampleAxis::Build(int srcLength, int dstLength,
+                                 const ResampleSettings& settings) {
+  ResampleAxis axis;
+  double scale = static_cast<double>(srcLength) / dstLength;
+
+  // area averaging covers the whole source footprint of each output pixel;
+  // when enlarging it degenerates to bilinear, like cv::INTER_AREA
+  bool area = settings.filter == ResizeFilter::AREA && scale > 1.0;
+
+  // the other kernels are sampled at source resolution like cv::resize,
+  // unless antialiasing stretches them over the footprint
+  double stretch = settings.antialias && scale > 1.0 ? scale : 1.0;
+  double radius = KernelRadius(settings.filter) * stretch;
+
+  axis.taps = area ? static_cast<int>(std::ceil(scale)) + 1
+                   : 2 * static_cast<int>(std::ceil(radius));
+  axis.index.resize(static_cast<size_t>(dstLength) * axis.taps);
+  axis.weight.resize(static_cast<size_t>(dstLength) * axis.taps);
+  axis.first.resize(dstLength);
+  axis.last.resize(dstLength);
+
+  std::vector<double> weights(axis.taps);
+  for (int d = 0; d < dstLength; ++d) {
+    int start;
+    if (area) {
+      double lo = d * scale, hi = (d + 1) * scale;
+      start = static_cast<int>(std::floor(lo));
+      for (int k = 0; k < axis.taps; ++k) {
+        int s = start + k;
+        weights[k] = std::max(0.0, std::min<double>(hi, s + 1) -
+                                       std::max<double>(lo, s));
+      }
+    } else {
+      // same pixel-center mapping as cv::resize, so the geometry is unchanged
+      double center = (d + 0.5) * scale - 0.5;
+      start = static_cast<int>(std::floor(center)) - axis.taps / 2 + 1;
+      for (int k = 0; k < axis.taps; ++k) {
+        weights[k] = Kernel(settings.filter, (start + k - center) / stretch);
+      }
+    }
+
+    double sum = 0.0;
+    for (double w : weights) sum += w;
+
+    int first = srcLength, last = 0;
+    for (int k = 0; k < axis.taps; ++k) {
+      int s = std::clamp(start + k, 0, srcLength - 1);
+      axis.index[d * axis.taps + k] = s;
+      axis.weight[d * axis.taps + k] = static_cast<float>(weights[k] / sum);
+      if (weights[k] != 0.0) {
+        first = std::min(first, s);
+        last = std::max(last, s);
+      }
+    }
+    axis.first[d] = first;
+    axis.last[d] = last;
+  }
+
+  return axis;
+}
+
+Resampler::Resampler(cv::Size srcSize, cv::Size dstSize, int channels,
+                     const ResampleSettings& settings)
+    : srcSize_(srcSize),
+      dstSize_(dstSize),
+      channels_(channels),
+      linearLight_(settings.linearLight),
+      alphaChannel_(channels == 4 ? 3 : channels == 2 ? 1 : -1),
+      xAxis_(ResampleAxis::Build(srcSize.width, dstSize.width, settings)),
+      yAxis_(ResampleAxis::Build(srcSize.height, dstSize.height, settings)) {
+  // the ring only has to hold the widest vertical footprint: rows older than
+  // that can no longer be referenced by any pending output row
+  rowNeeded_.assign(srcSize_.height, 0);
+  for (int d = 0; d < dstSize_.height; ++d) {
+    windowRows_ = std::max(windowRows_, yAxis_.last[d] - yAxis_.first[d] + 1);
+    for (int k = 0; k < yAxis_.taps; ++k) {
+      if (yAxis_.weight[d * yAxis_.taps + k] != 0.0f) {
+        rowNeeded_[yAxis_.index[d * yAxis_.taps + k]] = 1;
+      }
+    }
+  }
+
+  window_.resize(static_cast<size_t>(windowRows_) * dstSize_.width *
+                 channels_);
+  output_.create(dstSize_, CV_8UC(channels_));
+}
+
+cv::Mat Resampler::Resize(const cv::Mat& input, cv::Size dstSize,
+                          const ResampleSettings& settings, int threads) {
+  CV_Assert(input.depth() == CV_8U);
+
+  Resampler resampler(input.size(), dstSize, input.channels(), settings);
+
+  if (threads <= 0) {
+    threads = cv::getNumThreads();
+  }
+  int bands = std::max(1, std::min(threads, dstSize.height / kMinBandRows));
+
+  auto resizeBand = [&](int b) {
+    int dstBegin =
+        static_cast<int>(static_cast<int64_t>(dstSize.height) * b / bands);
+    int dstEnd = static_cast<int>(static_cast<int64_t>(dstSize.height) *
+                                  (b + 1) / bands);
+    resampler.ResizeBand(input, dstBegin, dstEnd);
+  };
+
+  // one thread per band, the caller's included. batch workers pass their
+  // share of the thread budget (ImageProcessor::ThreadsPerFile), so all
+  // files resized at once stay within cv::getNumThreads() threads
+  std::vector<std::thread> workers;
+  for (int b = 1; b < bands; ++b) {
+    workers.emplace_back(resizeBand, b);
+  }
+  resizeBand(0);
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  return resampler.Output();
+}
+
+void Resampler::PushRow(const uchar* row) {
+  int y = nextSrcRow_++;
+  if (y >= srcSize_.height) return;
+
+  FeedRow(y, row, window_.data(), nextDstRow_, dstSize_.height);
+}
+
+void Resampler::ResizeBand(const cv::Mat& input, int dstBegin, int dstEnd) {
+  if (dstBegin >= dstEnd) return;
+
+  std::vector<float> window(window_.size());
+  int nextDst = dstBegin;
+  for (int y = yAxis_.first[dstBegin];
+       y <= yAxis_.last[dstEnd - 1] && nextDst < dstEnd; ++y) {
+    FeedRow(y, input.ptr<uchar>(y), window.data(), nextDst, dstEnd);
+  }
+}
+
+void Resampler::FeedRow(int y, const uchar* row, float* window, int& nextDst,
+                        int dstEnd) {
+  if (!rowNeeded_[y]) {
+    // with large downscale factors most source rows are never sampled, so
+    // they do not even get a horizontal pass
+    return;
+  }
+
+  size_t rowFloats = static_cast<size_t>(dstSize_.width) * channels_;
+  float* out = window + (y % windowRows_) * rowFloats;
+
+  if (!linearLight_) {
+    HorizontalPass<uchar, false>(row, out);
+  } else if (static_cast<int64_t>(xAxis_.taps) * dstSize_.width <
+             2 * static_cast<int64_t>(srcSize_.width)) {
+    // a downscale reads each source pixel at most about twice, a table
+    // lookup per tap is cheaper than converting the whole row
+    HorizontalPass<uchar, true>(row, out);
+  } else {
+    // otherwise linearize the row once with the lookup table, then run the
+    // same float kernel as the 8-bit path
+    thread_local std::vector<float> linearRow;
+    const float* toLinear = GetSrgbTables().toLinear;
+    size_t count = static_cast<size_t>(srcSize_.width) * channels_;
+    linearRow.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+      linearRow[i] = toLinear[row[i]];
+    }
+    if (alphaChannel_ >= 0) {
+      for (size_t i = alphaChannel_; i < count; i += channels_) {
+        linearRow[i] = row[i];
+      }
+    }
+    HorizontalPass<float, false>(linearRow.data(), out);
+  }
+
+  while (nextDst < dstEnd && yAxis_.last[nextDst] <= y) {
+    VerticalPass(nextDst, window, output_.ptr<uchar>(nextDst));
+    ++nextDst;
+  }
+}
+
+template <typename T, bool Linear>
+void Resampler::HorizontalPass(const T* src, float* dst) const {
+  const int taps = xAxis_.taps;
+  const int cn = channels_;
+  const float* toLinear = Linear ? GetSrgbTables().toLinear : nullptr;
+  const int alpha = alphaChannel_;
+
+  for (int dx = 0; dx < dstSize_.width; ++dx) {
+    const int* index = &xAxis_.index[dx * taps];
+    const float* weight = &xAxis_.weight[dx * taps];
+    float* out = dst + dx * cn;
+
+    if (cn == 4) {
+      float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+      for (int k = 0; k < taps; ++k) {
+        const T* p = src + index[k] * 4;
+        float w = weight[k];
+        if constexpr (Linear) {
+          s0 += toLinear[p[0]] * w;
+          s1 += toLinear[p[1]] * w;
+          s2 += toLinear[p[2]] * w;
+        } else {
+          s0 += p[0] * w;
+          s1 += p[1] * w;
+          s2 += p[2] * w;
+        }
+        s3 += p[3] * w;
+      }
+      out[0] = s0;
+      out[1] = s1;
+      out[2] = s2;
+      out[3] = s3;
+    } else {
+      for (int c = 0; c < cn; ++c) {
+        float sum = 0;
+        for (int k = 0; k < taps; ++k) {
+          T v = src[index[k] * cn + c];
+          if constexpr (Linear) {
+            sum += (c != alpha ? toLinear[v] : v) * weight[k];
+          } else {
+            sum += v * weight[k];
+          }
+        }
+        out[c] = sum;
+      }
+    }
+  }
+}
+
+void Resampler::VerticalPass(int dstRow, const float* window,
+                             uchar* dst) const {
+  const int taps = yAxis_.taps;
+  const int* index = &yAxis_.index[dstRow * taps];
+  const float* weight = &yAxis_.weight[dstRow * taps];
+  const int rowFloats = dstSize_.width * channels_;
+
+  thread_local std::vector<const float*> rows;
+  rows.resize(taps);
+  for (int k = 0; k < taps; ++k) {
+    rows[k] = window + static_cast<size_t>(index[k] % windowRows_) * rowFloats;
+  }
+
+  if (!linearLight_) {
+    // contiguous over the row, so the compiler can vectorize this loop
+    for (int i = 0; i < rowFloats; ++i) {
+      float sum = 0;
+      for (int k = 0; k < taps; ++k) {
+        sum += rows[k][i] * weight[k];
+      }
+      dst[i] = cv::saturate_cast<uchar>(sum);
+    }
+    return;
+  }
+
+  thread_local std::vector<float> sums;
+  sums.resize(rowFloats);
+  for (int i = 0; i < rowFloats; ++i) {
+    float sum = 0;
+    for (int k = 0; k < taps; ++k) {
+      sum += rows[k][i] * weight[k];
+    }
+    sums[i] = sum;
+  }
+
+  // back to sRGB through the inverse table instead of pow()
+  const uchar* fromLinear = GetSrgbTables().fromLinear;
+  const float scale = static_cast<float>(kLinearSteps) / 255.0f;
+  for (int i = 0; i < rowFloats; ++i) {
+    int step = cvRound(sums[i] * scale);
+    dst[i] = fromLinear[std::clamp(step, 0, kLinearSteps)];
+  }
+  if (alphaChannel_ >= 0) {
+    for (int i = alphaChannel_; i < rowFloats; i += channels_) {
+      dst[i] = cv::saturate_cast<uchar>(sums[i]);
+    }
+  }
+}
+
+}  // namespace anysticker
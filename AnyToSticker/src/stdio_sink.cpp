@@ -0,0 +1,88 @@
+#include "../include/stdio_sink.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "../include/logger.h"
+
+namespace anysticker {
+
+namespace {
+
+// the windows console runtime translates line endings on text streams,
+// which corrupts image data
+void SetBinaryMode(FILE* stream) {
+#ifdef _WIN32
+  _setmode(_fileno(stream), _O_BINARY);
+#else
+  (void)stream;
+#endif
+}
+
+}  // namespace
+
+StdoutSink::StdoutSink() { SetBinaryMode(stdout); }
+
+bool StdoutSink::Write(const std::string& path,
+                       const std::vector<uchar>& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  // a second sticker would be glued onto the first one in the pipe
+  bool ok = !written_ &&
+            fwrite(data.data(), 1, data.size(), stdout) == data.size() &&
+            fflush(stdout) == 0;
+  if (!ok) {
+    Log(LogLevel::Error) << "Error: cannot write " << path
+                         << " to standard output";
+    failed_.insert(path);
+  }
+  written_ = true;
+  return ok;
+}
+
+bool StdoutSink::CopyFrom(const std::string& sourcePath,
+                          const std::string& path, bool hardLink) {
+  (void)hardLink;
+  std::ifstream file(sourcePath, std::ios::binary);
+  std::vector<uchar> data((std::istreambuf_iterator<char>(file)),
+                          std::istreambuf_iterator<char>());
+  if (!file.good() && !file.eof()) {
+    Log(LogLevel::Error) << "Error: cannot read " << sourcePath;
+    return false;
+  }
+  return Write(path, data);
+}
+
+bool StdoutSink::Finish() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_.empty();
+}
+
+std::set<std::string> StdoutSink::Failed() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+
+bool StdoutSink::DefersCommit() const { return false; }
+
+bool ReadStdin(std::vector<uchar>& data) {
+  SetBinaryMode(stdin);
+  data.clear();
+  uchar chunk[64 * 1024];
+  size_t count;
+  while ((count = fread(chunk, 1, sizeof(chunk), stdin)) > 0) {
+    data.insert(data.end(), chunk, chunk + count);
+  }
+  if (ferror(stdin)) {
+    Log(LogLevel::Error) << "Error: cannot read standard input";
+    return false;
+  }
+  return !data.empty();
+}
+
+}  // namespace anysticker
@@ -0,0 +1,73 @@
+#include "../include/trim.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace anysticker {
+
+namespace {
+
+// a BGRA pixel read as one 32-bit word, with only the alpha byte set
+uint32_t AlphaMask() {
+  const uchar bytes[4] = {0, 0, 0, 255};
+  uint32_t mask;
+  std::memcpy(&mask, bytes, sizeof(mask));
+  return mask;
+}
+
+// OR-reduce the pixels of [begin, end) and test the alpha byte once, the
+// branch-free loop vectorizes well
+bool AnyAlpha(const uint32_t* row, int begin, int end, uint32_t mask) {
+  uint32_t any = 0;
+  for (int x = begin; x < end; ++x) {
+    any |= row[x];
+  }
+  return (any & mask) != 0;
+}
+
+}  // namespace
+
+cv::Rect FindAlphaBounds(const cv::Mat& bgra) {
+  if (bgra.empty() || bgra.type() != CV_8UC4) return cv::Rect();
+
+  const uint32_t mask = AlphaMask();
+  const int width = bgra.cols, height = bgra.rows;
+  auto row = [&](int y) { return bgra.ptr<uint32_t>(y); };
+
+  int top = 0;
+  while (top < height && !AnyAlpha(row(top), 0, width, mask)) ++top;
+  if (top == height) return cv::Rect();
+
+  int bottom = height - 1;
+  while (bottom > top && !AnyAlpha(row(bottom), 0, width, mask)) --bottom;
+
+  // the first content row bounds both sides, every other row only has to
+  // look outside the bounds found so far and stops at its first hit
+  int left = width, right = -1;
+  for (int y = top; y <= bottom; ++y) {
+    const uint32_t* pixels = row(y);
+    for (int x = 0; x < left; ++x) {
+      if (pixels[x] & mask) {
+        left = x;
+        break;
+      }
+    }
+    for (int x = width - 1; x > right; --x) {
+      if (pixels[x] & mask) {
+        right = x;
+        break;
+      }
+    }
+    if (left == 0 && right == width - 1) break;
+  }
+
+  return cv::Rect(left, top, right - left + 1, bottom - top + 1);
+}
+
+cv::Mat TrimTransparent(const cv::Mat& bgra) {
+  cv::Rect bounds = FindAlphaBounds(bgra);
+  if (bounds.area() == 0) return bgra;
+  return bgra(bounds);
+}
+
+}  // namespace anysticker
@@ -0,0 +1,170 @@
+#include "../include/webp_encoder.h"
+
+#include <webp/encode.h>
+#include <webp/mux.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace anysticker {
+
+namespace {
+
+// per-thread encoder state, reused across files so a batch worker does not
+// re-initialize libwebp for every sticker
+struct WebpContext {
+  WebPConfig baseConfig;
+  WebPPicture picture;
+  bool ready = false;
+
+  WebpContext() {
+    ready = WebPConfigInit(&baseConfig) && WebPPictureInit(&picture);
+  }
+
+  ~WebpContext() { WebPPictureFree(&picture); }
+};
+
+// appends encoder output straight into the caller's buffer, which keeps its
+// capacity between files
+int VectorWriter(const uint8_t* data, size_t size, const WebPPicture* picture) {
+  auto* buffer = static_cast<std::vector<uchar>*>(picture->custom_ptr);
+  buffer->insert(buffer->end(), data, data + size);
+  return 1;
+}
+
+// encoder settings shared by still and animated outputs
+bool MakeConfig(const WebPConfig& base, const WebpOptions& webp, int quality,
+                bool lossless, WebPConfig& config) {
+  config = base;
+  config.lossless = lossless ? 1 : 0;
+  config.quality = static_cast<float>(std::clamp(quality, 0, 100));
+  config.method = std::clamp(webp.method, 0, 6);
+  config.thread_level = webp.threadLevel;
+  config.alpha_quality = std::clamp(webp.alphaQuality, 0, 100);
+  config.exact = webp.exact ? 1 : 0;
+  return WebPValidateConfig(&config) != 0;
+}
+
+bool IsLittleEndian() {
+  const uint32_t probe = 1;
+  uint8_t first;
+  std::memcpy(&first, &probe, 1);
+  return first == 1;
+}
+
+}  // namespace
+
+bool EncodeWebp(const cv::Mat& image, const WebpOptions& webp, int quality,
+                bool lossless, std::vector<uchar>& buffer) {
+  if (image.empty() || image.depth() != CV_8U) return false;
+
+  thread_local WebpContext context;
+  if (!context.ready) return false;
+
+  WebPConfig config;
+  if (!MakeConfig(context.baseConfig, webp, quality, lossless, config)) {
+    return false;
+  }
+
+  WebPPicture& picture = context.picture;
+  WebPPictureFree(&picture);
+  picture.width = image.cols;
+  picture.height = image.rows;
+  picture.use_argb = 1;
+
+  bool imported;
+  // on little-endian hosts BGRA bytes are exactly libwebp's 0xAARRGGBB words.
+  // lossy encoding only reads them while converting to YUV; lossless without
+  // `exact` rewrites transparent pixels in place, so that case gets a copy
+  if (image.channels() == 4 && IsLittleEndian() && (!lossless || webp.exact)) {
+    picture.argb = reinterpret_cast<uint32_t*>(const_cast<uchar*>(image.data));
+    picture.argb_stride = static_cast<int>(image.step / 4);
+    imported = true;
+  } else if (image.channels() == 4) {
+    imported = WebPPictureImportBGRA(&picture, image.data,
+                                     static_cast<int>(image.step)) != 0;
+  } else if (image.channels() == 3) {
+    imported = WebPPictureImportBGR(&picture, image.data,
+                                    static_cast<int>(image.step)) != 0;
+  } else {
+    return false;
+  }
+  if (!imported) return false;
+
+  buffer.clear();
+  picture.writer = VectorWriter;
+  picture.custom_ptr = &buffer;
+
+  bool ok = WebPEncode(&config, &picture) != 0;
+
+  // drop the borrowed pixels and any yuv planes, keep the context reusable
+  WebPPictureFree(&picture);
+  picture.argb = nullptr;
+  picture.writer = nullptr;
+  picture.custom_ptr = nullptr;
+  return ok;
+}
+
+AnimatedWebpEncoder::AnimatedWebpEncoder(cv::Size size,
+                                         const WebpOptions& webp,
+                                         int quality, bool lossless,
+                                         int loopCount)
+    : size_(size), webp_(webp), quality_(quality), lossless_(lossless) {
+  WebPAnimEncoderOptions options;
+  if (!WebPAnimEncoderOptionsInit(&options)) return;
+  options.anim_params.loop_count = loopCount;
+  options.anim_params.bgcolor = 0;  // transparent
+  encoder_ = WebPAnimEncoderNew(size.width, size.height, &options);
+}
+
+AnimatedWebpEncoder::~AnimatedWebpEncoder() {
+  if (encoder_) {
+    WebPAnimEncoderDelete(static_cast<WebPAnimEncoder*>(encoder_));
+  }
+}
+
+bool AnimatedWebpEncoder::AddFrame(const cv::Mat& frame, int timestampMs) {
+  if (!encoder_ || frame.size() != size_ || frame.type() != CV_8UC4) {
+    return false;
+  }
+
+  WebPConfig base;
+  WebPConfig config;
+  if (!WebPConfigInit(&base) ||
+      !MakeConfig(base, webp_, quality_, lossless_, config)) {
+    return false;
+  }
+
+  // the animation encoder keeps its own copy of every frame it needs
+  WebPPicture picture;
+  if (!WebPPictureInit(&picture)) return false;
+  picture.width = frame.cols;
+  picture.height = frame.rows;
+  picture.use_argb = 1;
+  bool ok = WebPPictureImportBGRA(&picture, frame.data,
+                                  static_cast<int>(frame.step)) &&
+            WebPAnimEncoderAdd(static_cast<WebPAnimEncoder*>(encoder_),
+                               &picture, timestampMs, &config);
+  WebPPictureFree(&picture);
+  return ok;
+}
+
+bool AnimatedWebpEncoder::Finish(int endTimestampMs,
+                                 std::vector<uchar>& buffer) {
+  if (!encoder_) return false;
+  auto* encoder = static_cast<WebPAnimEncoder*>(encoder_);
+
+  // a null frame marks the end time of the last one
+  WebPData data;
+  WebPDataInit(&data);
+  bool ok = WebPAnimEncoderAdd(encoder, nullptr, endTimestampMs, nullptr) &&
+            WebPAnimEncoderAssemble(encoder, &data);
+  if (ok) {
+    buffer.assign(data.bytes, data.bytes + data.size);
+  }
+  WebPDataClear(&data);
+  return ok;
+}
+
+}  // namespace anysticker
@@ -0,0 +1,284 @@
+#include "../include/archive_reader.h"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace anysticker {
+namespace {
+
+std::string Bytes(const std::vector<uchar>& data) {
+  return std::string(data.begin(), data.end());
+}
+
+// ---- tar ----
+
+void PutOctal(std::string& block, size_t offset, size_t width,
+              uint64_t value) {
+  std::string digits(width - 1, '0');
+  for (size_t i = width - 1; i-- > 0; value /= 8) {
+    digits[i] = static_cast<char>('0' + value % 8);
+  }
+  block.replace(offset, width - 1, digits);
+}
+
+// a ustar header block with a valid checksum
+std::string TarHeader(const std::string& name, size_t size, char type,
+                      const std::string& prefix = "") {
+  std::string block(512, '\0');
+  block.replace(0, name.size(), name);
+  PutOctal(block, 100, 8, 0644);
+  PutOctal(block, 124, 12, size);
+  block[156] = type;
+  block.replace(257, 6, std::string("ustar\0", 6));
+  block.replace(263, 2, "00");
+  block.replace(345, prefix.size(), prefix);
+  block.replace(148, 8, std::string(8, ' '));
+  unsigned sum = 0;
+  for (char c : block) sum += static_cast<unsigned char>(c);
+  PutOctal(block, 148, 7, sum);
+  return block;
+}
+
+std::string TarEntry(const std::string& name, const std::string& data,
+                     char type = '0', const std::string& prefix = "") {
+  std::string entry = TarHeader(name, data.size(), type, prefix) + data;
+  entry.resize((entry.size() + 511) / 512 * 512, '\0');
+  return entry;
+}
+
+// a pax record, whose length counts its own digits
+std::string PaxRecord(const std::string& key, const std::string& value) {
+  std::string body = " " + key + "=" + value + "\n";
+  size_t length = body.size() + 1;
+  while (std::to_string(length).size() + body.size() != length) ++length;
+  return std::to_string(length) + body;
+}
+
+std::string TarEnd() { return std::string(1024, '\0'); }
+
+// ---- zip ----
+
+void PutLe16(std::string& out, uint16_t value) {
+  out += static_cast<char>(value & 0xFF);
+  out += static_cast<char>(value >> 8);
+}
+
+void PutLe32(std::string& out, uint32_t value) {
+  PutLe16(out, static_cast<uint16_t>(value & 0xFFFF));
+  PutLe16(out, static_cast<uint16_t>(value >> 16));
+}
+
+std::string RawDeflate(const std::string& data) {
+  z_stream stream{};
+  deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8,
+               Z_DEFAULT_STRATEGY);
+  std::string out(deflateBound(&stream, static_cast<uLong>(data.size())), '\0');
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+  stream.avail_in = static_cast<uInt>(data.size());
+  stream.next_out = reinterpret_cast<Bytef*>(&out[0]);
+  stream.avail_out = static_cast<uInt>(out.size());
+  deflate(&stream, Z_FINISH);
+  out.resize(stream.total_out);
+  deflateEnd(&stream);
+  return out;
+}
+
+struct ZipFile {
+  std::string name;
+  std::string data;
+  uint16_t method = 0;
+};
+
+// a zip with the given files; localOffsetShift moves the local header
+// offsets recorded in the central directory
+std::string BuildZip(const std::vector<ZipFile>& files,
+                     uint32_t localOffsetShift = 0) {
+  std::string zip;
+  std::string directory;
+  for (const ZipFile& file : files) {
+    std::string stored =
+        file.method == 8 ? RawDeflate(file.data) : file.data;
+    uint32_t crc = static_cast<uint32_t>(
+        crc32(0L, reinterpret_cast<const Bytef*>(file.data.data()),
+              static_cast<uInt>(file.data.size())));
+    uint32_t offset = static_cast<uint32_t>(zip.size());
+
+    PutLe32(zip, 0x04034b50);
+    PutLe16(zip, 20);
+    PutLe16(zip, 0);
+    PutLe16(zip, file.method);
+    PutLe32(zip, 0);
+    PutLe32(zip, crc);
+    PutLe32(zip, static_cast<uint32_t>(stored.size()));
+    PutLe32(zip, static_cast<uint32_t>(file.data.size()));
+    PutLe16(zip, static_cast<uint16_t>(file.name.size()));
+    PutLe16(zip, 0);
+    zip += file.name + stored;
+
+    PutLe32(directory, 0x02014b50);
+    PutLe16(directory, 20);
+    PutLe16(directory, 20);
+    PutLe16(directory, 0);
+    PutLe16(directory, file.method);
+    PutLe32(directory, 0);
+    PutLe32(directory, crc);
+    PutLe32(directory, static_cast<uint32_t>(stored.size()));
+    PutLe32(directory, static_cast<uint32_t>(file.data.size()));
+    PutLe16(directory, static_cast<uint16_t>(file.name.size()));
+    PutLe16(directory, 0);
+    PutLe16(directory, 0);
+    PutLe16(directory, 0);
+    PutLe16(directory, 0);
+    PutLe32(directory, 0);
+    PutLe32(directory, offset + localOffsetShift);
+    directory += file.name;
+  }
+
+  uint32_t directoryOffset = static_cast<uint32_t>(zip.size());
+  zip += directory;
+  PutLe32(zip, 0x06054b50);
+  PutLe16(zip, 0);
+  PutLe16(zip, 0);
+  PutLe16(zip, static_cast<uint16_t>(files.size()));
+  PutLe16(zip, static_cast<uint16_t>(files.size()));
+  PutLe32(zip, static_cast<uint32_t>(directory.size()));
+  PutLe32(zip, directoryOffset);
+  PutLe16(zip, 0);
+  return zip;
+}
+
+// ---- tests ----
+
+TEST(ArchiveReaderReadsTar) {
+  std::string longName(150, 'n');
+  std::string tar = TarEntry("a.png", "first") +
+                    TarEntry("dir/", "", '5') +
+                    TarEntry("b.png", std::string(700, 'b'), '0', "sub") +
+                    TarEntry("././@LongLink", longName + ".png", 'L') +
+                    TarEntry("truncated", "long") +
+                    TarEntry("pax", PaxRecord("mtime", "1") +
+                                        PaxRecord("path", "pax/c.png"),
+                             'x') +
+                    TarEntry("ignored", "third") +
+                    TarEntry("link", "", '2') + TarEnd();
+  std::string path = test::TempPath("reader.tar");
+  CHECK(test::WriteFile(path, tar));
+
+  ArchiveReader reader;
+  CHECK(reader.Open(path));
+  const std::vector<ArchiveEntry>& entries = reader.Entries();
+  CHECK(entries.size() == 4);
+  if (entries.size() == 4) {
+    CHECK(entries[0].name == "a.png");
+    CHECK(entries[1].name == "sub/b.png");
+    CHECK(entries[2].name == longName + ".png");
+    CHECK(entries[3].name == "pax/c.png");
+
+    std::vector<uchar> data;
+    CHECK(reader.Extract(entries[0], data) && Bytes(data) == "first");
+    CHECK(reader.Extract(entries[1], data) &&
+          Bytes(data) == std::string(700, 'b'));
+    CHECK(reader.Extract(entries[2], data) && Bytes(data) == "long");
+    CHECK(reader.Extract(entries[3], data) && Bytes(data) == "third");
+  }
+  std::remove(path.c_str());
+}
+
+TEST(ArchiveReaderRejectsCorruptTar) {
+  std::string path = test::TempPath("corrupt.tar");
+
+  // a flipped byte in the header breaks its checksum
+  std::string tar = TarEntry("a.png", "first") + TarEnd();
+  tar[0] = 'b';
+  CHECK(test::WriteFile(path, tar));
+  ArchiveReader badChecksum;
+  CHECK(!badChecksum.Open(path));
+
+  // an entry claiming more data than the archive holds
+  tar = TarHeader("a.png", 4096, '0') + std::string(512, 'x');
+  CHECK(test::WriteFile(path, tar));
+  ArchiveReader truncated;
+  CHECK(!truncated.Open(path));
+  std::remove(path.c_str());
+}
+
+TEST(ArchiveReaderReadsZip) {
+  std::string big;
+  for (int i = 0; i < 5000; ++i) big += "sticker " + std::to_string(i) + "\n";
+  std::string zip = BuildZip({{"stored.png", "plain bytes", 0},
+                              {"dir/", "", 0},
+                              {"dir/deflated.png", big, 8},
+                              {"empty.png", "", 8},
+                              {"bzip2.png", "unsupported", 12}});
+  std::string path = test::TempPath("reader.zip");
+  CHECK(test::WriteFile(path, zip));
+
+  ArchiveReader reader;
+  CHECK(reader.Open(path));
+  const std::vector<ArchiveEntry>& entries = reader.Entries();
+  CHECK(entries.size() == 3);
+  if (entries.size() == 3) {
+    CHECK(entries[0].name == "stored.png");
+    CHECK(entries[1].name == "dir/deflated.png");
+    CHECK(entries[1].method == 8);
+    CHECK(entries[1].storedSize < big.size());
+    CHECK(entries[2].name == "empty.png");
+
+    std::vector<uchar> data;
+    CHECK(reader.Extract(entries[0], data) && Bytes(data) == "plain bytes");
+    CHECK(reader.Extract(entries[1], data) && Bytes(data) == big);
+    CHECK(reader.Extract(entries[2], data) && data.empty());
+
+    // a wrong crc or a size the data cannot inflate to is an error
+    ArchiveEntry entry = entries[1];
+    entry.crc ^= 1;
+    CHECK(!reader.Extract(entry, data));
+    entry = entries[1];
+    entry.size += 1;
+    CHECK(!reader.Extract(entry, data));
+    entry = entries[0];
+    entry.crc ^= 1;
+    CHECK(!reader.Extract(entry, data));
+  }
+  std::remove(path.c_str());
+}
+
+TEST(ArchiveReaderRejectsCorruptZip) {
+  std::string path = test::TempPath("corrupt.zip");
+
+  // local header offsets pointing past the end of the file
+  CHECK(test::WriteFile(path, BuildZip({{"a.png", "data", 0}}, 0x7FFFFFF0)));
+  ArchiveReader badOffset;
+  CHECK(!badOffset.Open(path));
+
+  // no end of central directory record at all
+  CHECK(test::WriteFile(path, std::string(100, 'z')));
+  ArchiveReader notZip;
+  CHECK(!notZip.Open(path));
+
+  // an empty file cannot be mapped
+  CHECK(test::WriteFile(path, ""));
+  ArchiveReader empty;
+  CHECK(!empty.Open(path));
+  std::remove(path.c_str());
+}
+
+TEST(ArchiveReaderIsArchivePath) {
+  std::string zip = test::TempPath("is_archive.ZIP");
+  std::string png = test::TempPath("is_archive.png");
+  CHECK(test::WriteFile(zip, BuildZip({})));
+  CHECK(test::WriteFile(png, "x"));
+  CHECK(ArchiveReader::IsArchivePath(zip));
+  CHECK(!ArchiveReader::IsArchivePath(png));
+  CHECK(!ArchiveReader::IsArchivePath(test::TempPath("missing.tar")));
+  std::remove(zip.c_str());
+  std::remove(png.c_str());
+}
+
+}  // namespace
+}  // namespace anysticker
@@ -0,0 +1,112 @@
+#include "../include/image_format.h"
+
+#include <cstdio>
+#include <string>
+
+#include "test.h"
+
+namespace anysticker {
+namespace {
+
+const std::string kPngSignature("\x89PNG\r\n\x1a\n", 8);
+
+// a png chunk of the given type with length zero-filled bytes and a dummy crc
+std::string Chunk(const char* type, size_t length) {
+  std::string chunk;
+  for (int shift = 24; shift >= 0; shift -= 8) {
+    chunk += static_cast<char>((length >> shift) & 0xFF);
+  }
+  chunk += type;
+  chunk += std::string(length, '\0');
+  chunk += "CRC!";
+  return chunk;
+}
+
+// a RIFF/WEBP header followed by the given chunk fourcc
+std::string WebpHeader(const char* fourcc) {
+  return std::string("RIFF\0\0\0\0WEBP", 12) + fourcc;
+}
+
+InputFormat Sniff(const std::string& bytes) {
+  return SniffFormat(reinterpret_cast<const uchar*>(bytes.data()),
+                     bytes.size());
+}
+
+TEST(SniffFormatRecognizesMagicNumbers) {
+  CHECK(Sniff(kPngSignature + Chunk("IHDR", 13)).format == ImageFormat::PNG);
+  CHECK(Sniff(std::string("\xFF\xD8\xFF\xE0", 4)).format ==
+        ImageFormat::JPEG);
+  CHECK(Sniff("GIF87a").format == ImageFormat::GIF);
+  CHECK(Sniff("GIF89a").format == ImageFormat::GIF);
+  CHECK(Sniff(WebpHeader("VP8 ") + std::string(8, '\0')).format ==
+        ImageFormat::WEBP);
+  CHECK(Sniff("BM" + std::string(24, '\0')).format == ImageFormat::BMP);
+  CHECK(Sniff(std::string("II*\0", 4)).format == ImageFormat::TIFF);
+  CHECK(Sniff(std::string("MM\0*", 4)).format == ImageFormat::TIFF);
+}
+
+TEST(SniffFormatRejectsUnknownAndShortInput) {
+  CHECK(Sniff("").format == ImageFormat::UNKNOWN);
+  CHECK(Sniff("hello world").format == ImageFormat::UNKNOWN);
+  CHECK(Sniff(kPngSignature.substr(0, 7)).format == ImageFormat::UNKNOWN);
+  // a bmp header is at least 26 bytes
+  CHECK(Sniff("BM" + std::string(10, '\0')).format == ImageFormat::UNKNOWN);
+  CHECK(std::string(FormatName(ImageFormat::UNKNOWN)) == "unknown");
+  CHECK(std::string(FormatName(ImageFormat::WEBP)) == "webp");
+}
+
+TEST(SniffFormatAnimation) {
+  CHECK(Sniff("GIF89a").animated);
+  CHECK(!Sniff(std::string("\xFF\xD8\xFF\xE0", 4)).animated);
+
+  std::string still = kPngSignature + Chunk("IHDR", 13) + Chunk("IDAT", 10);
+  CHECK(!Sniff(still).animated);
+  std::string apng = kPngSignature + Chunk("IHDR", 13) + Chunk("acTL", 8) +
+                     Chunk("IDAT", 10);
+  CHECK(Sniff(apng).animated);
+
+  // acTL after the first IDAT does not make an apng
+  std::string late = still + Chunk("acTL", 8);
+  CHECK(!Sniff(late).animated);
+
+  // a chunk length running past the end stops the walk
+  std::string truncated = kPngSignature + "\xFF\xFF\xFF\xF0" "iCCP";
+  CHECK(Sniff(truncated).format == ImageFormat::PNG);
+  CHECK(!Sniff(truncated).animated);
+
+  // the flags byte follows the VP8X chunk size
+  std::string vp8x = WebpHeader("VP8X") + std::string(14, '\0');
+  CHECK(!Sniff(vp8x).animated);
+  vp8x[20] = 0x02;
+  CHECK(Sniff(vp8x).animated);
+}
+
+TEST(SniffFileFindsAcTLBehindLargeChunks) {
+  std::string apng = kPngSignature + Chunk("IHDR", 13) +
+                     Chunk("iCCP", kSniffBytes * 4) + Chunk("acTL", 8) +
+                     Chunk("IDAT", 10);
+  std::string path = test::TempPath("sniff_apng.png");
+  CHECK(test::WriteFile(path, apng));
+  InputFormat format = SniffFile(path);
+  CHECK(format.format == ImageFormat::PNG);
+  CHECK(format.animated);
+  CHECK(Sniff(apng).animated);
+
+  std::string still = kPngSignature + Chunk("IHDR", 13) +
+                      Chunk("iCCP", kSniffBytes * 4) + Chunk("IDAT", 10) +
+                      Chunk("acTL", 8);
+  CHECK(test::WriteFile(path, still));
+  format = SniffFile(path);
+  CHECK(format.format == ImageFormat::PNG);
+  CHECK(!format.animated);
+  std::remove(path.c_str());
+}
+
+TEST(SniffFileMissingFile) {
+  InputFormat format = SniffFile(test::TempPath("does_not_exist.png"));
+  CHECK(format.format == ImageFormat::UNKNOWN);
+  CHECK(!format.animated);
+}
+
+}  // namespace
+}  // namespace anysticker
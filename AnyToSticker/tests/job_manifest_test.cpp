@@ -0,0 +1,127 @@
+#include "../include/job_manifest.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "test.h"
+
+namespace anysticker {
+namespace {
+
+// writes the manifest text to a temp file and reads every job from it
+std::vector<Job> ReadJobs(const std::string& text,
+                          const ProcessingOptions& defaults) {
+  std::string path = test::TempPath("manifest.ndjson");
+  std::vector<Job> jobs;
+  CHECK(test::WriteFile(path, text));
+  JobManifest manifest(path, defaults);
+  CHECK(manifest.Open());
+  Job job;
+  while (manifest.Next(job)) jobs.push_back(job);
+  std::remove(path.c_str());
+  return jobs;
+}
+
+std::vector<Job> ReadJobs(const std::string& text) {
+  return ReadJobs(text, ProcessingOptions());
+}
+
+TEST(ManifestAppliesOverridesOnTopOfDefaults) {
+  ProcessingOptions defaults;
+  defaults.quality = 80;
+  defaults.outputs = {{OutputFormat::PNG, 512}, {OutputFormat::WEBP, 512},
+                      {OutputFormat::PNG, 100}};
+  std::vector<Job> jobs = ReadJobs(
+      "{\"input\": \"a.png\"}\n"
+      "{\"input\": \"b.jpg\", \"output\": \"out/b.webp\", \"format\": "
+      "\"webp\", \"quality\": 250, \"budget\": 64, \"quantize\": true, "
+      "\"trim\": true, \"remove_bg\": true, \"bg_tolerance\": 20.4, "
+      "\"filter\": \"mitchell\", \"passthrough\": false}\n",
+      defaults);
+  CHECK(jobs.size() == 2);
+  if (jobs.size() != 2) return;
+
+  const Job& plain = jobs[0];
+  CHECK(plain.error.empty());
+  CHECK(plain.line == 1);
+  CHECK(plain.inputPath == "a.png");
+  CHECK(plain.outputPath.empty());
+  CHECK(plain.options.quality == 80);
+  CHECK(plain.options.outputs.size() == 3);
+
+  const Job& custom = jobs[1];
+  CHECK(custom.error.empty());
+  CHECK(custom.line == 2);
+  CHECK(custom.inputPath == "b.jpg");
+  CHECK(custom.outputPath == "out/b.webp");
+  CHECK(custom.options.format == OutputFormat::WEBP);
+  CHECK(custom.options.quality == 100);
+  CHECK(custom.options.sizeBudget == 64 * 1024);
+  CHECK(custom.options.quantize);
+  CHECK(custom.options.trim);
+  CHECK(custom.options.removeBackground);
+  CHECK(custom.options.background.tolerance == 20);
+  CHECK(custom.options.filter == ResizeFilter::MITCHELL);
+  CHECK(!custom.options.passthrough);
+  // the format replaces --formats and keeps each size once
+  CHECK(custom.options.outputs.size() == 2);
+  for (const OutputSpec& spec : custom.options.outputs) {
+    CHECK(spec.format == OutputFormat::WEBP);
+  }
+}
+
+TEST(ManifestSkipsBlankLinesAndCountsThem) {
+  std::vector<Job> jobs = ReadJobs(
+      "\n   \r\n{\"input\": \"a.png\"}\r\n\t\n{\"input\": \"b.png\"}");
+  CHECK(jobs.size() == 2);
+  if (jobs.size() != 2) return;
+  CHECK(jobs[0].line == 3);
+  CHECK(jobs[0].error.empty());
+  CHECK(jobs[1].line == 5);
+  CHECK(jobs[1].inputPath == "b.png");
+}
+
+TEST(ManifestDecodesStringEscapes) {
+  std::vector<Job> jobs = ReadJobs(
+      "{\"input\": \"dir\\\\a \\\"b\\\"\\u00e9\\ud83d\\ude00.png\"}\n");
+  CHECK(jobs.size() == 1);
+  if (jobs.empty()) return;
+  CHECK(jobs[0].error.empty());
+  CHECK(jobs[0].inputPath == "dir\\a \"b\"\xC3\xA9\xF0\x9F\x98\x80.png");
+}
+
+TEST(ManifestReportsBadLinesAndContinues) {
+  std::vector<Job> jobs = ReadJobs(
+      "{\"output\": \"x.png\"}\n"
+      "{\"input\": \"a.png\", \"size\": 512}\n"
+      "{\"input\": 42}\n"
+      "{\"input\": \"a.png\", \"format\": \"gif\"}\n"
+      "{\"input\": \"a.png\", \"filter\": \"nearest\"}\n"
+      "{\"input\": \"a.png\", \"trim\": 1}\n"
+      "{\"input\": \"a.png\"\n"
+      "{\"input\": \"a.png\"} trailing\n"
+      "{\"input\": {\"nested\": true}}\n"
+      "{\"input\": \"ok.png\"}\n");
+  CHECK(jobs.size() == 10);
+  if (jobs.size() != 10) return;
+  CHECK(jobs[0].error == "missing input");
+  CHECK(jobs[1].error == "unknown field size");
+  CHECK(jobs[2].error == "input must be a string");
+  CHECK(jobs[3].error == "unknown format gif");
+  CHECK(jobs[4].error == "unknown filter nearest");
+  CHECK(jobs[5].error == "trim must be true or false");
+  CHECK(jobs[6].error == "expected ',' or '}' at column 18");
+  CHECK(jobs[7].error == "trailing characters at column 20");
+  CHECK(jobs[8].error.find("bad value for input") == 0);
+  CHECK(jobs[9].error.empty());
+  CHECK(jobs[9].line == 10);
+}
+
+TEST(ManifestOpenFailsForMissingFile) {
+  JobManifest manifest(test::TempPath("missing.ndjson"), ProcessingOptions());
+  CHECK(!manifest.Open());
+}
+
+}  // namespace
+}  // namespace anysticker
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace anysticker {
+namespace test {
+
+// 最小的测试注册表：TEST 定义的函数在启动时登记，由 test_main.cpp 依次运行
+struct TestCase {
+  const char* name;
+  void (*run)();
+};
+
+inline std::vector<TestCase>& Registry() {
+  static std::vector<TestCase> tests;
+  return tests;
+}
+
+// 所有测试累计失败的检查数
+inline int& Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+struct Registrar {
+  Registrar(const char* name, void (*run)()) {
+    Registry().push_back({name, run});
+  }
+};
+
+// 测试用的临时文件路径（位于系统临时目录）
+std::string TempPath(const std::string& name);
+
+// 将 data 写入 path，失败时返回 false
+bool WriteFile(const std::string& path, const std::string& data);
+
+}  // namespace test
+}  // namespace anysticker
+
+#define TEST(name)                                                   \
+  static void name();                                                \
+  static ::anysticker::test::Registrar name##_registrar(#name, name); \
+  static void name()
+
+#define CHECK(condition)                                                    \
+  do {                                                                      \
+    if (!(condition)) {                                                     \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, \
+                   #condition);                                             \
+      ++::anysticker::test::Failures();                                     \
+    }                                                                       \
+  } while (0)
@@ -0,0 +1,41 @@
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+#include "test.h"
+
+namespace anysticker {
+namespace test {
+
+std::string TempPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / ("anysticker_" + name))
+      .string();
+}
+
+bool WriteFile(const std::string& path, const std::string& data) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  return static_cast<bool>(file);
+}
+
+}  // namespace test
+}  // namespace anysticker
+
+// runs every registered test, or only those whose name contains argv[1]
+int main(int argc, char* argv[]) {
+  using namespace anysticker::test;
+  std::string filter = argc > 1 ? argv[1] : "";
+  int failed = 0;
+  int run = 0;
+  for (const TestCase& test : Registry()) {
+    if (std::string(test.name).find(filter) == std::string::npos) continue;
+    int before = Failures();
+    test.run();
+    ++run;
+    bool ok = Failures() == before;
+    if (!ok) ++failed;
+    std::printf("[%s] %s\n", ok ? "  OK  " : " FAIL ", test.name);
+  }
+  std::printf("%d of %d tests passed\n", run - failed, run);
+  return failed == 0 ? 0 : 1;
+}